@@ -0,0 +1,217 @@
+#include "../src/shin.h"
+
+#include <chrono>
+
+/*
+ * Buffer microbenchmarks. Prints one CSV row per (operation, buffer size, pattern):
+ *
+ *     operation,buffer_size,pattern,iterations,ns_per_op
+ *
+ * usage: shin_buffer_bench [-min-size BYTES] [-max-size BYTES] [-budget-ms MS]
+ * sizes accept K, M and G suffixes.
+ */
+
+#define BENCH_POSITIONS 4096
+#define BENCH_MAX_ITERATIONS (1 << 20)
+#define BENCH_LINE_LENGTH 64
+
+enum BenchPattern {
+	PATTERN_LOCAL = 0,
+	PATTERN_RANDOM,
+	PATTERN_APPEND,
+	PATTERNS_COUNT
+};
+
+const char *PATTERN_NAMES[PATTERNS_COUNT] = {
+	"local", "random", "append"
+};
+
+struct Bench {
+	Buffer *buffer;
+	u32 size;
+	f64 budget_ns;
+	u32 positions[PATTERNS_COUNT][BENCH_POSITIONS];
+};
+
+static u64 rng_state = 0x9E3779B97F4A7C15ULL;
+
+static u32 rng_next() {
+	// xorshift64
+	rng_state ^= rng_state << 13;
+	rng_state ^= rng_state >> 7;
+	rng_state ^= rng_state << 17;
+	return (u32) (rng_state >> 32);
+}
+
+static f64 time_now_ns() {
+	auto now = std::chrono::steady_clock::now().time_since_epoch();
+	return std::chrono::duration<f64, std::nano>(now).count();
+}
+
+static u32 parse_size(const char *str) {
+	char *end;
+	u64 size = strtoull(str, &end, 10);
+
+	switch (*end) {
+		case 'k': case 'K': size <<= 10; break;
+		case 'm': case 'M': size <<= 20; break;
+		case 'g': case 'G': size <<= 30; break;
+	}
+
+	return (u32) MIN(size, (u64) UINT32_MAX / 2);
+}
+
+static Buffer *bench_buffer_create(u32 size) {
+	Buffer *buffer = buffer_create(size + 64);
+
+	// lines of words so that line and word motions have something to do
+	for (u32 i = 0; i < size; ++i) {
+		u32 column = i % BENCH_LINE_LENGTH;
+		char ch = 'a' + (i % 26);
+
+		if (column == BENCH_LINE_LENGTH - 1) ch = '\n';
+		else if (column % 8 == 7) ch = ' ';
+
+		buffer->data[i] = ch;
+	}
+	buffer->gap_start = size;
+
+	return buffer;
+}
+
+static void bench_generate_positions(Bench *bench) {
+	u32 length = buffer_length(bench->buffer);
+	u32 local = length / 2;
+
+	for (u32 i = 0; i < BENCH_POSITIONS; ++i) {
+		// typing drifts forward a little around one spot
+		bench->positions[PATTERN_LOCAL][i] = MIN(local + (i % 64), length);
+		bench->positions[PATTERN_RANDOM][i] = length ? rng_next() % length : 0;
+		bench->positions[PATTERN_APPEND][i] = length;
+	}
+}
+
+template<typename F>
+static void bench_measure(Bench *bench, const char *operation, u32 pattern, F fn) {
+	u32 *positions = bench->positions[pattern];
+
+	u32 iterations = 0;
+	f64 start = time_now_ns();
+	f64 elapsed = 0;
+
+	// run in growing batches until the time budget is used up
+	u32 batch = 1;
+	while (elapsed < bench->budget_ns && iterations < BENCH_MAX_ITERATIONS) {
+		for (u32 i = 0; i < batch; ++i) {
+			u32 pos = positions[(iterations + i) % BENCH_POSITIONS];
+			if (pattern == PATTERN_APPEND) {
+				pos = buffer_length(bench->buffer);
+			}
+
+			fn(MIN(pos, buffer_length(bench->buffer)));
+		}
+
+		iterations += batch;
+		batch = MIN(batch * 2, MIN(4096, BENCH_MAX_ITERATIONS - iterations));
+		elapsed = time_now_ns() - start;
+	}
+
+	printf("%s,%u,%s,%u,%.2f\n", operation, bench->size, PATTERN_NAMES[pattern], iterations, elapsed / iterations);
+	fflush(stdout);
+}
+
+typedef u32 (*CursorFunction)(Buffer *buffer, u32 cursor);
+
+struct CursorBench {
+	const char *name;
+	CursorFunction function;
+};
+
+const CursorBench CURSOR_BENCHES[] = {
+	{"cursor_next", cursor_next},
+	{"cursor_back", cursor_back},
+	{"cursor_get_beginning_of_line", cursor_get_beginning_of_line},
+	{"cursor_get_end_of_line", cursor_get_end_of_line},
+	{"cursor_get_beginning_of_next_line", cursor_get_beginning_of_next_line},
+	{"cursor_get_beginning_of_prev_line", cursor_get_beginning_of_prev_line},
+	{"cursor_get_end_of_prev_line", cursor_get_end_of_prev_line},
+	{"cursor_get_end_of_next_line", cursor_get_end_of_next_line},
+	{"buffer_get_cell_column", buffer_get_cell_column},
+	{"cursor_get_beginning_of_word", cursor_get_beginning_of_word},
+	{"cursor_get_end_of_word", cursor_get_end_of_word},
+	{"cursor_get_next_word", cursor_get_next_word},
+	{"cursor_get_prev_word", cursor_get_prev_word},
+};
+
+static void bench_size(u32 size, f64 budget_ns) {
+	Bench *bench = (Bench *) malloc(sizeof(Bench));
+	bench->size = size;
+	bench->budget_ns = budget_ns;
+	bench->buffer = bench_buffer_create(size);
+	bench_generate_positions(bench);
+
+	Buffer *buffer = bench->buffer;
+	volatile u32 sink = 0;
+
+	// read-only operations first so every size sees the same content
+	for (u32 pattern = 0; pattern < PATTERNS_COUNT; ++pattern) {
+		for (const CursorBench &cursor_bench : CURSOR_BENCHES) {
+			bench_measure(bench, cursor_bench.name, pattern, [&](u32 pos) {
+				sink = sink + cursor_bench.function(buffer, pos);
+			});
+		}
+
+		char line[256];
+		bench_measure(bench, "buffer_get_line", pattern, [&](u32 pos) {
+			u32 cursor = cursor_get_beginning_of_line(buffer, pos);
+			sink = sink + buffer_get_line(buffer, line, sizeof(line), &cursor);
+		});
+	}
+
+	for (u32 pattern = 0; pattern < PATTERNS_COUNT; ++pattern) {
+		bench_measure(bench, "buffer_shift_gap_to_position", pattern, [&](u32 pos) {
+			buffer_shift_gap_to_position(buffer, pos);
+		});
+
+		bench_measure(bench, "buffer_insert", pattern, [&](u32 pos) {
+			buffer_insert(buffer, pos, 'x');
+		});
+
+		bench_measure(bench, "buffer_delete_multiple", pattern, [&](u32 pos) {
+			if (pattern == PATTERN_APPEND) {
+				pos = buffer_length(buffer) ? buffer_length(buffer) - 1 : 0;
+			}
+			buffer_delete_multiple(buffer, pos, 1);
+		});
+	}
+
+	buffer_destroy(buffer);
+	free(bench);
+}
+
+int main(int argc, char **argv) {
+	u32 min_size = 1 << 10;
+	u32 max_size = 1 << 30;
+	f64 budget_ms = 50;
+
+	for (s32 i = 1; i < argc; ++i) {
+		char *arg = argv[i];
+		bool has_value = i + 1 < argc;
+
+		if (strcmp(arg, "-min-size") == 0 && has_value) min_size = parse_size(argv[++i]);
+		else if (strcmp(arg, "-max-size") == 0 && has_value) max_size = parse_size(argv[++i]);
+		else if (strcmp(arg, "-budget-ms") == 0 && has_value) budget_ms = atof(argv[++i]);
+		else {
+			puts("usage: shin_buffer_bench [-min-size BYTES] [-max-size BYTES] [-budget-ms MS]");
+			return 1;
+		}
+	}
+
+	printf("operation,buffer_size,pattern,iterations,ns_per_op\n");
+
+	for (u64 size = MAX(min_size, 1); size <= max_size; size *= 32) {
+		bench_size((u32) size, budget_ms * 1000000.0);
+	}
+
+	return 0;
+}
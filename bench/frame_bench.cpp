@@ -0,0 +1,226 @@
+#include "../src/shin.h"
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+/*
+ * Headless frame benchmark: drives Editor + DrawBuffer + the software
+ * rasterizer without a window and reports per-stage timings.
+ *
+ * usage: shin_frame_bench <file> [-frames N] [-scroll LINES] [-edit-every FRAMES]
+ *                         [-width PX] [-height PX] [-font PATH] [-font-size PX]
+ *                         [-replay TRACE [-max-speed]]
+ *
+ * With -replay the scripted scrolling is replaced by the recorded input events
+ * and keystroke to frame latencies are reported as well.
+ */
+
+enum BenchStage {
+	STAGE_SCROLL = 0,
+	STAGE_HIGHLIGHT,
+	STAGE_CELL_FILL,
+	STAGE_RASTERIZE,
+	STAGE_TOTAL,
+	STAGES_COUNT
+};
+
+const char *STAGE_NAMES[STAGES_COUNT] = {
+	"scroll", "highlight", "cell_fill", "rasterize", "total"
+};
+
+struct FrameBench {
+	Editor *editor;
+	DrawBuffer *draw_buffer;
+	GlyphMap *glyph_map;
+	u32 *screen;
+	s32 width;
+	s32 height;
+
+	Array<f64> samples[STAGES_COUNT];
+};
+
+static f64 time_now_us() {
+	auto now = std::chrono::steady_clock::now().time_since_epoch();
+	return std::chrono::duration<f64, std::micro>(now).count();
+}
+
+static void bench_frame(FrameBench *bench) {
+	Editor *editor = bench->editor;
+	DrawBuffer *draw_buffer = bench->draw_buffer;
+	Pane *active_pane = &editor->pane_pool[editor->active_pane_index];
+
+	f64 t0 = time_now_us();
+	memset(draw_buffer->cells, 0, draw_buffer->cells_size);
+	pane_update_scroll(active_pane);
+
+	f64 t1 = time_now_us();
+	highlighting_parse(active_pane);
+
+	f64 t2 = time_now_us();
+	for (u32 i = 0; i < editor->pane_count; ++i) {
+		render_pane(editor, draw_buffer, &editor->pane_pool[i], i == editor->active_pane_index);
+	}
+
+	f64 t3 = time_now_us();
+	software_rasterize(draw_buffer, bench->glyph_map, bench->screen, bench->width, bench->height,
+					   editor->settings.colors);
+
+	f64 t4 = time_now_us();
+
+	bench->samples[STAGE_SCROLL].add(t1 - t0);
+	bench->samples[STAGE_HIGHLIGHT].add(t2 - t1);
+	bench->samples[STAGE_CELL_FILL].add(t3 - t2);
+	bench->samples[STAGE_RASTERIZE].add(t4 - t3);
+	bench->samples[STAGE_TOTAL].add(t4 - t0);
+}
+
+static void bench_replay(FrameBench *bench, InputTrace *trace, bool max_speed) {
+	Editor *editor = bench->editor;
+
+	input_trace_replay_begin(trace, time_now_us() / 1000000.0, max_speed);
+
+	while (!input_trace_replay_done(trace)) {
+		f64 now = time_now_us() / 1000000.0;
+
+		// sleep until the next recorded event is due
+		f64 next_time = input_trace_next_event_time(trace);
+		if (!max_speed && next_time > now) {
+			std::this_thread::sleep_for(std::chrono::duration<f64>(next_time - now));
+			now = time_now_us() / 1000000.0;
+		}
+
+		InputEvent input_event;
+		while (input_trace_replay_next(trace, now, &input_event)) {
+			editor->last_input_event = input_event;
+			keymap_dispatch_event(editor);
+		}
+
+		bench_frame(bench);
+		input_trace_frame_presented(trace, time_now_us() / 1000000.0);
+	}
+}
+
+static f64 percentile(Array<f64> *samples, f64 p) {
+	if (samples->length == 0) return 0;
+
+	s64 index = (s64) (p * (samples->length - 1) + 0.5);
+	return (*samples)[index];
+}
+
+static void script_step(Buffer *buffer, u32 frame, u32 scroll_lines, u32 edit_every) {
+	for (u32 i = 0; i < scroll_lines; ++i) {
+		if (cursor_get_end_of_line(buffer, buffer->cursor) == buffer_length(buffer)) {
+			buffer_goto_beginning(buffer);
+		} else {
+			buffer_goto_next_line(buffer);
+		}
+	}
+
+	// alternate between typing a character and removing it again
+	if (edit_every && frame % edit_every == 0) {
+		if ((frame / edit_every) % 2 == 0) {
+			buffer_insert(buffer, buffer->cursor, 'x');
+		} else {
+			buffer_delete_backwards(buffer, buffer->cursor);
+		}
+	}
+}
+
+int main(int argc, char **argv) {
+	const char *file_path = 0;
+	const char *font = "resources/Consolas.ttf";
+	u32 font_size = 20;
+	u32 frames = 1000;
+	u32 scroll_lines = 1;
+	u32 edit_every = 8;
+	s32 width = 1280;
+	s32 height = 720;
+	const char *replay_path = 0;
+	bool max_speed = false;
+
+	for (s32 i = 1; i < argc; ++i) {
+		char *arg = argv[i];
+		bool has_value = i + 1 < argc;
+
+		if (strcmp(arg, "-frames") == 0 && has_value) frames = atoi(argv[++i]);
+		else if (strcmp(arg, "-scroll") == 0 && has_value) scroll_lines = atoi(argv[++i]);
+		else if (strcmp(arg, "-edit-every") == 0 && has_value) edit_every = atoi(argv[++i]);
+		else if (strcmp(arg, "-width") == 0 && has_value) width = atoi(argv[++i]);
+		else if (strcmp(arg, "-height") == 0 && has_value) height = atoi(argv[++i]);
+		else if (strcmp(arg, "-font") == 0 && has_value) font = argv[++i];
+		else if (strcmp(arg, "-font-size") == 0 && has_value) font_size = atoi(argv[++i]);
+		else if (strcmp(arg, "-replay") == 0 && has_value) replay_path = argv[++i];
+		else if (strcmp(arg, "-max-speed") == 0) max_speed = true;
+		else file_path = arg;
+	}
+
+	if (!file_path) {
+		puts("usage: shin_frame_bench <file> [-frames N] [-scroll LINES] [-edit-every FRAMES]");
+		puts("                        [-width PX] [-height PX] [-font PATH] [-font-size PX]");
+		puts("                        [-replay TRACE [-max-speed]]");
+		return 1;
+	}
+
+	InputTrace trace;
+	if (replay_path && !input_trace_load(&trace, replay_path)) {
+		printf("Failed to load input trace %s!\n", replay_path);
+		return 1;
+	}
+
+	Editor editor = {0};
+	editor.running = true;
+
+	Settings *settings = &editor.settings;
+	set_default_settings(settings);
+	settings->font_size = font_size;
+	create_default_keymaps(&editor);
+
+	Pane *pane = pane_create(&editor, {0, 0, 30, 20});
+	pane->buffer->file_path = strdup(file_path);
+	read_file_to_buffer(pane->buffer);
+	load_wait_all(false);
+
+	glyph_map_init();
+	GlyphMap *glyph_map = glyph_map_create(font, font_size);
+
+	DrawBuffer draw_buffer = {0};
+	draw_buffer_init(&draw_buffer);
+	draw_buffer_resize(&editor, &draw_buffer, glyph_map, width, height);
+
+	FrameBench bench;
+	bench.editor = &editor;
+	bench.draw_buffer = &draw_buffer;
+	bench.glyph_map = glyph_map;
+	bench.screen = (u32 *) malloc(width * height * sizeof(u32));
+	bench.width = width;
+	bench.height = height;
+
+	if (replay_path) {
+		bench_replay(&bench, &trace, max_speed);
+	} else {
+		for (u32 frame = 0; frame < frames; ++frame) {
+			script_step(editor.current_buffer, frame, scroll_lines, edit_every);
+			bench_frame(&bench);
+		}
+	}
+
+	printf("file: %s (%u bytes), frames: %lld, grid: %ux%u, window: %dx%d\n",
+		   file_path, buffer_length(pane->buffer), (long long) bench.samples[STAGE_TOTAL].length,
+		   draw_buffer.columns, draw_buffer.rows, width, height);
+	printf("%-10s %10s %10s %10s %10s\n", "stage", "p50 us", "p90 us", "p99 us", "max us");
+
+	for (u32 i = 0; i < STAGES_COUNT; ++i) {
+		Array<f64> *stage = &bench.samples[i];
+		std::sort(stage->begin(), stage->end());
+
+		printf("%-10s %10.1f %10.1f %10.1f %10.1f\n", STAGE_NAMES[i],
+			   percentile(stage, 0.50), percentile(stage, 0.90), percentile(stage, 0.99), percentile(stage, 1.0));
+	}
+
+	if (replay_path) {
+		input_trace_report(&trace);
+	}
+
+	return 0;
+}
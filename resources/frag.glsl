@@ -3,11 +3,10 @@
 const uint GLYPH_INVERT = 0x1;
 const uint GLYPH_BLINK = 0x2;
 
+// glyph index in the low 16 bits, then flags and the foreground palette index, the background palette index in the next word
 struct Cell {
-	uint index;
-	uint flags;
-	uint fg;
-	uint bg;
+	uint glyph;
+	uint colors;
 };
 
 layout(origin_upper_left) in vec4 gl_FragCoord;
@@ -25,6 +24,7 @@ uniform uvec2 grid_size;
 uniform uvec2 win_size;
 uniform float time;
 uniform uint background_color;
+uniform uint palette[16];
 
 vec3 unpack_color(uint cp) {
 	uint r = (cp >> 16) & 0xFFu;
@@ -35,7 +35,7 @@ vec3 unpack_color(uint cp) {
 }
 
 void main() {
-	vec3 default_bg = unpack_color(cells[0].bg);
+	vec3 default_bg = unpack_color(palette[0]);
 	uvec2 screen_pos = uvec2(floor(gl_FragCoord.xy));
 
 	vec3 pixel;
@@ -44,9 +44,13 @@ void main() {
 		uvec2 cell_pos = screen_pos % cell_size;
 
 		Cell cell = cells[cell_index.x + cell_index.y * grid_size.x];
+		uint glyph_index = cell.glyph & 0xFFFFu;
+		uint cell_flags = (cell.glyph >> 16) & 0xFFu;
+		uint cell_fg = palette[cell.glyph >> 24];
+		uint cell_bg = palette[cell.colors & 0xFFu];
 
-		uint cell_x = cell.index % 32u;
-		uint cell_y = cell.index / 32u;
+		uint cell_x = glyph_index % 32u;
+		uint cell_y = glyph_index / 32u;
 
 		vec4 texel = texelFetch(glyph_map, ivec2(
 			cell_x * cell_size.x + cell_pos.x,
@@ -55,11 +59,11 @@ void main() {
 		
 		float blink_time = time * 3;
 		float blink_curve = abs(sin(blink_time) + cos(blink_time + 1.05));
-		float blink = 1.0 - float(cell.flags & GLYPH_BLINK) * blink_curve;
-		vec3 invert = vec3(cell.flags & GLYPH_INVERT);
+		float blink = 1.0 - float(cell_flags & GLYPH_BLINK) * blink_curve;
+		vec3 invert = vec3(cell_flags & GLYPH_INVERT);
 
-		vec3 fg = abs(invert - unpack_color(cell.fg)) * blink;
-		vec3 bg = abs(invert - unpack_color(cell.bg)) * blink;
+		vec3 fg = abs(invert - unpack_color(cell_fg)) * blink;
+		vec3 bg = abs(invert - unpack_color(cell_bg)) * blink;
 
 		vec3 bg_black = step(vec3(0.01), bg);
 		bg += (vec3(1.0) - bg_black) * unpack_color(background_color);
@@ -2,19 +2,19 @@
 
 const uint GLYPH_INVERT = 0x1;
 const uint GLYPH_BLINK = 0x2;
-const uint UINT_MAX = 4294967295u;
 
 layout(origin_upper_left) in vec4 gl_FragCoord;
 layout(location = 0) out vec4 color;
 
 uniform sampler2D glyph_map;
-uniform sampler2D cells;
+uniform usampler2D cells;
 
 uniform uvec2 cell_size;
 uniform uvec2 grid_size;
 uniform uvec2 win_size;
 uniform float time;
 uniform uint background_color;
+uniform uint palette[16];
 
 vec3 unpack_color(uint cp) {
 	uint r = (cp >> 16) & 0xFFu;
@@ -33,11 +33,12 @@ void main() {
 		uvec2 cell_index = uvec2(floor(screen_pos / cell_size));
 		uvec2 cell_pos = screen_pos % cell_size;
 
-		vec4 cell = texelFetch(cells, ivec2(cell_index), 0);
-		uint glyph_index = uint(cell.x * win_size.x);
-		uint cell_flags = uint(cell.y * UINT_MAX);
-		uint cell_fg = uint(cell.z * UINT_MAX);
-		uint cell_bg = uint(cell.w * UINT_MAX);
+		// glyph index in the low 16 bits, then flags and the foreground palette index, the background palette index in g
+		uvec2 cell = texelFetch(cells, ivec2(cell_index), 0).rg;
+		uint glyph_index = cell.x & 0xFFFFu;
+		uint cell_flags = (cell.x >> 16) & 0xFFu;
+		uint cell_fg = palette[cell.x >> 24];
+		uint cell_bg = palette[cell.y & 0xFFu];
 
 		uint cell_x = glyph_index % 32u;
 		uint cell_y = glyph_index / 32u;
@@ -1,7 +1,7 @@
 #include "shin.h"
 
 Buffer *buffer_create(u32 size) {
-	Buffer *buffer = (Buffer *) malloc(sizeof(Buffer));
+	Buffer *buffer = new Buffer;
 
 	buffer->data = (char *) malloc(size);
 	buffer->file_path = 0;
@@ -13,12 +13,34 @@ Buffer *buffer_create(u32 size) {
 	buffer->cursor = 0;
 	buffer->cursor_width = 0;
 
+	buffer->line_starts.add(0);
+	buffer->lines_scanned = 0;
+
+	buffer->line_rows.add(0);
+	buffer->wrap_width = 0;
+	buffer->tab_width = 1;
+
+	buffer->edit_version = 0;
+	buffer->saved_version = 0;
+
+	buffer->disk_size = 0;
+	buffer->disk_mtime = 0;
+	buffer->changed_on_disk = false;
+	buffer->load_deferred = false;
+	buffer->load_incomplete = false;
+	buffer->load_cursor = UINT32_MAX;
+	buffer->watch_pending = false;
+
+	buffer->save_job = 0;
+	buffer->load_job = 0;
+	buffer->journal = 0;
+
 	return buffer;
 }
 
 void buffer_destroy(Buffer *buffer) {
 	free(buffer->data);
-	free(buffer);
+	delete buffer;
 }
 
 u32 buffer_gap_size(Buffer *buffer) {
@@ -38,7 +60,18 @@ char buffer_get_char(Buffer *buffer, u32 cursor) {
 }
 
 void buffer_set_char(Buffer *buffer, u32 cursor, char ch) {
-	buffer->data[buffer_data_index(buffer, cursor)] = ch;
+	if (buffer->load_job) return;
+
+	buffer->edit_version++;
+	buffer_invalidate_lines(buffer, cursor);
+	journal_replace(buffer, cursor, ch);
+
+	u32 index = buffer_data_index(buffer, cursor);
+	if (buffer->save_job) {
+		save_prepare_edit(buffer, index, index + 1);
+	}
+
+	buffer->data[index] = ch;
 }
 
 void buffer_set_cursor(Buffer *buffer, u32 cursor) {
@@ -88,11 +121,19 @@ u32 buffer_get_line(Buffer *buffer, char *line, u32 line_size, u32 *cursor) {
 void buffer_shift_gap_to_position(Buffer *buffer, u32 pos) {
 	if (pos < buffer->gap_start) {
 		u32 gap_delta = buffer->gap_start - pos;
+		if (buffer->save_job) {
+			save_prepare_edit(buffer, buffer->gap_end - gap_delta, buffer->gap_end);
+		}
+
 		buffer->gap_start -= gap_delta;
 		buffer->gap_end -= gap_delta;
 		memmove(buffer->data + buffer->gap_end, buffer->data + buffer->gap_start, gap_delta);
 	} else if (pos > buffer->gap_start) {
 		u32 gap_delta = pos - buffer->gap_start;
+		if (buffer->save_job) {
+			save_prepare_edit(buffer, buffer->gap_start, buffer->gap_start + gap_delta);
+		}
+
 		memmove(buffer->data + buffer->gap_start, buffer->data + buffer->gap_end, gap_delta);
 		buffer->gap_start += gap_delta;
 		buffer->gap_end += gap_delta;
@@ -104,6 +145,11 @@ void buffer_grow_if_needed(Buffer *buffer, u32 size_needed) {
 	if (buffer_gap_size(buffer) < size_needed) {
 		buffer_shift_gap_to_position(buffer, buffer_length(buffer));
 
+		// realloc would free the data a background save is still writing
+		if (buffer->save_job) {
+			save_prepare_edit(buffer, 0, buffer->size);
+		}
+
 		u32 new_size = MAX(buffer->size * 2, buffer->size + size_needed - buffer_gap_size(buffer));
 
 		buffer->data = (char *) realloc(buffer->data, new_size);
@@ -118,14 +164,29 @@ void buffer_clear(Buffer *buffer) {
 	buffer->gap_start = 0;	
 	buffer->gap_end = buffer->size;
 	buffer->cursor = 0;
+	buffer->cursors.clear();
+	buffer->line_starts.resize(1);
+	buffer->lines_scanned = 0;
+	buffer->line_rows.resize(1);
+	buffer->line_kinds.clear();
 }
 
 void buffer_insert(Buffer *buffer, u32 pos, char ch) {
 	buffer_asserts(buffer);
 
+	if (buffer->load_job) return;
+
+	buffer->edit_version++;
+	buffer_invalidate_lines(buffer, pos);
+	journal_insert(buffer, pos, ch);
+
 	buffer_grow_if_needed(buffer, 64);
 	buffer_shift_gap_to_position(buffer, pos);
 
+	if (buffer->save_job) {
+		save_prepare_edit(buffer, buffer->gap_start, buffer->gap_start + 1);
+	}
+
 	buffer->data[buffer->gap_start] = ch;
 	buffer->gap_start++;
 
@@ -134,6 +195,240 @@ void buffer_insert(Buffer *buffer, u32 pos, char ch) {
 	}
 }
 
+// one gap shift and one copy however long the text is
+void buffer_insert_multiple(Buffer *buffer, u32 pos, const char *text, u32 length) {
+	buffer_asserts(buffer);
+
+	if (buffer->load_job || length == 0) return;
+
+	buffer->edit_version++;
+	buffer_invalidate_lines(buffer, pos);
+	journal_insert_text(buffer, pos, text, length);
+
+	buffer_grow_if_needed(buffer, length);
+	buffer_shift_gap_to_position(buffer, pos);
+
+	if (buffer->save_job) {
+		save_prepare_edit(buffer, buffer->gap_start, buffer->gap_start + length);
+	}
+
+	memcpy(buffer->data + buffer->gap_start, text, length);
+	buffer->gap_start += length;
+
+	if (buffer->cursor >= pos) {
+		buffer->cursor += length;
+	}
+}
+
+// copies [from, to) out of both sides of the gap
+void buffer_get_text(Buffer *buffer, u32 from, u32 to, char *text) {
+	BufferSpan spans[2];
+	u32 count = buffer_get_spans(buffer, from, to, spans);
+	for (u32 i = 0; i < count; ++i) {
+		memcpy(text, spans[i].data, spans[i].length);
+		text += spans[i].length;
+	}
+}
+
+// at most two spans, the one before the gap first, empty ones are left out
+u32 buffer_get_spans(Buffer *buffer, u32 from, u32 to, BufferSpan spans[2]) {
+	u32 count = 0;
+
+	if (from < buffer->gap_start && from < to) {
+		u32 end = MIN(to, buffer->gap_start);
+		spans[count++] = {buffer->data + from, end - from, from};
+		from = end;
+	}
+
+	if (from < to) {
+		spans[count++] = {buffer->data + from + buffer_gap_size(buffer), to - from, from};
+	}
+
+	return count;
+}
+
+// the primary cursor joins the others in one ascending list, returns its index
+static u32 buffer_gather_cursors(Buffer *buffer, Array<u32> *positions) {
+	positions->reserve(buffer->cursors.length + 1);
+
+	u32 primary = 0;
+	for (u32 cursor : buffer->cursors) {
+		if (cursor < buffer->cursor) primary++;
+	}
+
+	for (s64 i = 0; i < buffer->cursors.length; ++i) {
+		if (i == primary) positions->add(buffer->cursor);
+		positions->add(buffer->cursors[i]);
+	}
+	if (primary == buffer->cursors.length) positions->add(buffer->cursor);
+
+	return primary;
+}
+
+// cursors that an edit or motion moved onto the same position become one
+static void buffer_scatter_cursors(Buffer *buffer, Array<u32> *positions, u32 primary) {
+	buffer->cursor = (*positions)[primary];
+	buffer->cursors.clear();
+
+	for (u32 pos : *positions) {
+		if (pos == buffer->cursor) continue;
+		if (buffer->cursors.length > 0 && buffer->cursors[buffer->cursors.length - 1] == pos) continue;
+
+		buffer->cursors.add(pos);
+	}
+}
+
+// back to front, so the positions still to be edited do not move and the gap crosses the text once
+void buffer_insert_at_cursors(Buffer *buffer, const char *text, u32 length) {
+	if (buffer->cursors.length == 0) {
+		if (length == 1) {
+			buffer_insert(buffer, buffer->cursor, text[0]);
+		} else {
+			buffer_insert_multiple(buffer, buffer->cursor, text, length);
+		}
+		return;
+	}
+
+	if (buffer->load_job) return;
+
+	Array<u32> positions;
+	u32 primary = buffer_gather_cursors(buffer, &positions);
+
+	// grow once up front rather than while the gap is halfway through the text
+	buffer_grow_if_needed(buffer, (u32) positions.length * length + 64);
+
+	for (s64 i = positions.length - 1; i >= 0; --i) {
+		if (length == 1) {
+			buffer_insert(buffer, positions[i], text[0]);
+		} else {
+			buffer_insert_multiple(buffer, positions[i], text, length);
+		}
+	}
+
+	for (s64 i = 0; i < positions.length; ++i) {
+		positions[i] += (u32) (i + 1) * length;
+	}
+
+	buffer_scatter_cursors(buffer, &positions, primary);
+}
+
+void buffer_delete_at_cursors(Buffer *buffer, bool forwards) {
+	if (buffer->cursors.length == 0) {
+		if (forwards) {
+			buffer_delete_forwards(buffer, buffer->cursor);
+		} else {
+			buffer_delete_backwards(buffer, buffer->cursor);
+		}
+		return;
+	}
+
+	if (buffer->load_job) return;
+
+	Array<u32> positions;
+	u32 primary = buffer_gather_cursors(buffer, &positions);
+
+	// bytes removed at each cursor, a cursor moves back by everything removed before it
+	Array<u32> deleted(positions.length);
+	deleted.resize(positions.length);
+
+	for (s64 i = positions.length - 1; i >= 0; --i) {
+		u32 length = buffer_length(buffer);
+		if (forwards) {
+			buffer_delete_forwards(buffer, positions[i]);
+		} else {
+			buffer_delete_backwards(buffer, positions[i]);
+		}
+		deleted[i] = length - buffer_length(buffer);
+	}
+
+	u32 deleted_before = 0;
+	for (s64 i = 0; i < positions.length; ++i) {
+		if (!forwards) {
+			deleted_before += deleted[i];
+		}
+		positions[i] -= deleted_before;
+		if (forwards) {
+			deleted_before += deleted[i];
+		}
+	}
+
+	buffer_scatter_cursors(buffer, &positions, primary);
+}
+
+void buffer_move_cursors(Buffer *buffer, u32 (*move)(Buffer *buffer, u32 cursor)) {
+	if (buffer->cursors.length == 0) {
+		buffer->cursor = move(buffer, buffer->cursor);
+		return;
+	}
+
+	Array<u32> positions;
+	u32 primary = buffer_gather_cursors(buffer, &positions);
+
+	for (u32 &pos : positions) {
+		pos = move(buffer, pos);
+	}
+
+	buffer_scatter_cursors(buffer, &positions, primary);
+}
+
+void buffer_add_cursor(Buffer *buffer, u32 pos) {
+	Array<u32> *cursors = &buffer->cursors;
+	if (pos == buffer->cursor || pos > buffer_length(buffer)) return;
+
+	s64 index = 0;
+	s64 high = cursors->length;
+	while (index < high) {
+		s64 middle = (index + high) / 2;
+		if ((*cursors)[middle] < pos) {
+			index = middle + 1;
+		} else {
+			high = middle;
+		}
+	}
+
+	if (index < cursors->length && (*cursors)[index] == pos) return;
+
+	cursors->add(pos);
+	memmove(cursors->data + index + 1, cursors->data + index, (cursors->length - index - 1) * sizeof(u32));
+	(*cursors)[index] = pos;
+}
+
+void buffer_clear_cursors(Buffer *buffer) {
+	buffer->cursors.clear();
+}
+
+// first occurrence of text at or after from, buffer_length if there is none
+u32 buffer_find(Buffer *buffer, const char *text, u32 length, u32 from) {
+	u32 end = buffer_length(buffer);
+	if (length == 0) return end;
+
+	while ((u64) from + length <= end) {
+		// memchr finds the candidates on each side of the gap, the rest is compared across it
+		bool before_gap = from < buffer->gap_start;
+		u32 segment_end = before_gap ? buffer->gap_start : end;
+		const char *segment = before_gap ? buffer->data : buffer->data + buffer_gap_size(buffer);
+
+		const char *found = (const char *) memchr(segment + from, text[0], segment_end - from);
+		if (!found) {
+			from = segment_end;
+			continue;
+		}
+
+		from = (u32) (found - segment);
+		if ((u64) from + length > end) break;
+
+		u32 i = 1;
+		while (i < length && buffer_get_char(buffer, from + i) == text[i]) {
+			i++;
+		}
+		if (i == length) return from;
+
+		from++;
+	}
+
+	return end;
+}
+
 void buffer_replace(Buffer *buffer, u32 pos, char ch) {
 	buffer_asserts(buffer);
 
@@ -145,12 +440,19 @@ void buffer_replace(Buffer *buffer, u32 pos, char ch) {
 void buffer_delete_forwards(Buffer *buffer, u32 pos) {
 	buffer_asserts(buffer);
 
+	if (buffer->load_job) return;
+
 	if (pos < buffer_length(buffer)) {
+		buffer->edit_version++;
+		buffer_invalidate_lines(buffer, pos);
+		u32 count = cursor_next(buffer, pos) - pos;
+		journal_delete(buffer, pos, count);
+
 		buffer_shift_gap_to_position(buffer, pos);
-		buffer->gap_end++;
+		buffer->gap_end += count;
 
 		if (buffer->cursor > pos) {
-			buffer->cursor--;
+			buffer->cursor -= count;
 		}
 	}
 }
@@ -158,11 +460,18 @@ void buffer_delete_forwards(Buffer *buffer, u32 pos) {
 void buffer_delete_backwards(Buffer *buffer, u32 pos) {
 	buffer_asserts(buffer);
 
+	if (buffer->load_job) return;
+
 	if (pos > 0) {
+		u32 count = pos - cursor_back(buffer, pos);
+		buffer->edit_version++;
+		buffer_invalidate_lines(buffer, pos - count);
+		journal_delete(buffer, pos - count, count);
+
 		buffer_shift_gap_to_position(buffer, pos);
-		buffer->gap_start--;
+		buffer->gap_start -= count;
 		if (buffer->cursor >= pos) {
-			buffer->cursor--;
+			buffer->cursor -= count;
 		}
 	}
 }
@@ -170,7 +479,12 @@ void buffer_delete_backwards(Buffer *buffer, u32 pos) {
 void buffer_delete_multiple(Buffer *buffer, u32 pos, u32 count) {
 	buffer_asserts(buffer);
 
+	if (buffer->load_job) return;
+
 	if (pos < buffer_length(buffer)) {
+		buffer->edit_version++;
+		buffer_invalidate_lines(buffer, pos);
+		journal_delete(buffer, pos, MIN(count, buffer_length(buffer) - pos));
 		buffer_shift_gap_to_position(buffer, pos);
 		buffer->gap_end += count;
 		buffer->gap_end = MIN(buffer->gap_end, buffer->size);
@@ -185,23 +499,438 @@ void buffer_delete_multiple(Buffer *buffer, u32 pos, u32 count) {
 	}
 }
 
+// ranges are count ascending from, to pairs that do not overlap, deleted front to back in one pass:
+// the gap moves over each kept stretch once and swallows each range, instead of a full edit per range
+void buffer_delete_ranges(Buffer *buffer, const u32 *ranges, u32 count) {
+	buffer_asserts(buffer);
+
+	if (buffer->load_job || count == 0) return;
+
+	buffer->edit_version++;
+	buffer_invalidate_lines(buffer, ranges[0]);
+
+	u32 cursor = buffer->cursor;
+	u32 deleted = 0;
+	for (u32 i = 0; i < count; ++i) {
+		u32 from = ranges[2 * i] - deleted;
+		u32 length = ranges[2 * i + 1] - ranges[2 * i];
+		if (length == 0) continue;
+
+		journal_delete(buffer, from, length);
+		buffer_shift_gap_to_position(buffer, from);
+		buffer->gap_end += length;
+
+		if (buffer->cursor >= ranges[2 * i + 1]) {
+			cursor -= length;
+		} else if (buffer->cursor > ranges[2 * i]) {
+			cursor -= buffer->cursor - ranges[2 * i];
+		}
+
+		deleted += length;
+	}
+
+	buffer->cursor = cursor;
+}
+
+bool buffer_is_dirty(Buffer *buffer) {
+	return buffer->edit_version != buffer->saved_version || buffer->load_incomplete;
+}
+
+// index of the last indexed line starting at or before pos
+static u32 buffer_find_indexed_line(Buffer *buffer, u32 pos) {
+	Array<u32> *line_starts = &buffer->line_starts;
+
+	s64 low = 0;
+	s64 high = line_starts->length - 1;
+	while (low < high) {
+		s64 middle = (low + high + 1) / 2;
+		if (line_starts->data[middle] <= pos) {
+			low = middle;
+		} else {
+			high = middle - 1;
+		}
+	}
+
+	return (u32) low;
+}
+
+void buffer_invalidate_lines(Buffer *buffer, u32 pos) {
+	Array<u32> *line_starts = &buffer->line_starts;
+
+	buffer->lines_scanned = MIN(buffer->lines_scanned, pos);
+
+	// the line holding pos is changing, whether it is plain is worked out again
+	u32 line = buffer_find_indexed_line(buffer, pos);
+	if (buffer->line_kinds.length > line) {
+		buffer->line_kinds.resize(line);
+	}
+
+	// drop every indexed line that starts after pos, they are rebuilt on demand
+	if (line_starts->data[line_starts->length - 1] <= pos) return;
+
+	line_starts->resize(line + 1);
+
+	// the first row of a line only depends on the lines before it
+	if (buffer->line_rows.length > line_starts->length) {
+		buffer->line_rows.resize(line_starts->length);
+	}
+}
+
+static u32 buffer_find_newline(Buffer *buffer, u32 from) {
+	u32 length = buffer_length(buffer);
+
+	if (from < buffer->gap_start) {
+		char *found = (char *) memchr(buffer->data + from, '\n', buffer->gap_start - from);
+		if (found) {
+			return (u32) (found - buffer->data);
+		}
+		from = buffer->gap_start;
+	}
+
+	if (from < length) {
+		char *segment = buffer->data + buffer_gap_size(buffer);
+		char *found = (char *) memchr(segment + from, '\n', length - from);
+		if (found) {
+			return (u32) (found - segment);
+		}
+	}
+
+	return length;
+}
+
+u32 buffer_get_line_start(Buffer *buffer, u32 line) {
+	Array<u32> *line_starts = &buffer->line_starts;
+
+	while (line >= line_starts->length) {
+		u32 newline = buffer_find_newline(buffer, MAX(line_starts->data[line_starts->length - 1], buffer->lines_scanned));
+		if (newline == buffer_length(buffer)) {
+			buffer->lines_scanned = newline;
+			break;
+		}
+
+		line_starts->add(newline + 1);
+	}
+
+	return line_starts->data[MIN(line, (u32) line_starts->length - 1)];
+}
+
+u32 buffer_get_line_index(Buffer *buffer, u32 pos) {
+	Array<u32> *line_starts = &buffer->line_starts;
+
+	// the line holding pos is known once a later one is indexed or the end is reached
+	while (line_starts->data[line_starts->length - 1] <= pos) {
+		u32 newline = buffer_find_newline(buffer, MAX(line_starts->data[line_starts->length - 1], buffer->lines_scanned));
+		if (newline == buffer_length(buffer)) {
+			buffer->lines_scanned = newline;
+			break;
+		}
+
+		line_starts->add(newline + 1);
+	}
+
+	return buffer_find_indexed_line(buffer, pos);
+}
+
+// the cell to is at when from is at cell, a tab runs to the next multiple of tab_width and continuation bytes take none
+u32 buffer_advance_cells(Buffer *buffer, u32 from, u32 to, u32 cell) {
+	u32 tab_width = buffer->tab_width;
+
+	BufferSpan spans[2];
+	u32 count = buffer_get_spans(buffer, from, to, spans);
+	for (u32 i = 0; i < count; ++i) {
+		const char *text = spans[i].data;
+		const char *end = text + spans[i].length;
+
+		// the text between tabs is counted in bulk, only a tab needs the cell it starts at
+		while (text < end) {
+			const char *tab = (const char *) memchr(text, '\t', end - text);
+			cell += utf8_count_codepoints(text, (u32) ((tab ? tab : end) - text));
+			if (!tab) break;
+
+			cell += tab_width - cell % tab_width;
+			text = tab + 1;
+		}
+	}
+
+	return cell;
+}
+
+// walks a line from a position at from_cell to the character covering the given cell, or to the
+// end of the line, and gives the cell that character starts at
+u32 buffer_find_cell(Buffer *buffer, u32 from, u32 from_cell, u32 cell, u32 *found_cell) {
+	u32 cells = from_cell;
+
+	// stops at the line break rather than searching for it first, long lines are only walked as far as needed
+	BufferSpan spans[2];
+	u32 count = buffer_get_spans(buffer, from, buffer_length(buffer), spans);
+	for (u32 i = 0; i < count; ++i) {
+		for (u32 j = 0; j < spans[i].length; ++j) {
+			char ch = spans[i].data[j];
+			if (ch == '\n') {
+				if (found_cell) *found_cell = cells;
+				return spans[i].pos + j;
+			}
+			if (UTF8_IS_CONTINUATION(ch)) continue;
+
+			u32 width = ch == '\t' ? buffer->tab_width - cells % buffer->tab_width : 1;
+			if (cells + width > cell) {
+				if (found_cell) *found_cell = cells;
+				return spans[i].pos + j;
+			}
+			cells += width;
+		}
+	}
+
+	if (found_cell) *found_cell = cells;
+	return buffer_length(buffer);
+}
+
+// whether text has a tab in it, without one its cells can be counted from either end
+static bool buffer_has_tab(Buffer *buffer, u32 from, u32 to) {
+	BufferSpan spans[2];
+	u32 count = buffer_get_spans(buffer, from, to, spans);
+	for (u32 i = 0; i < count; ++i) {
+		if (memchr(spans[i].data, '\t', spans[i].length)) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+// a plain line is ascii without tabs, the answer is kept until the line is edited
+static bool buffer_is_line_plain(Buffer *buffer, u32 line) {
+	Array<u8> *line_kinds = &buffer->line_kinds;
+	while (line_kinds->length <= line) {
+		line_kinds->add(LINE_UNKNOWN);
+	}
+
+	if (line_kinds->data[line] == LINE_UNKNOWN) {
+		BufferSpan spans[2];
+		u32 count = buffer_get_spans(buffer, buffer_get_line_start(buffer, line), buffer_get_line_end(buffer, line), spans);
+
+		bool is_plain = true;
+		for (u32 i = 0; i < count; ++i) {
+			is_plain = is_plain && utf8_is_ascii(spans[i].data, spans[i].length) && !memchr(spans[i].data, '\t', spans[i].length);
+		}
+		line_kinds->data[line] = is_plain ? LINE_PLAIN : LINE_MIXED;
+	}
+
+	return line_kinds->data[line] == LINE_PLAIN;
+}
+
+// visual column of pos, read off the line index for plain lines and counted from the line start otherwise
+u32 buffer_get_cell_column(Buffer *buffer, u32 pos) {
+	u32 line = buffer_get_line_index(buffer, pos);
+	u32 line_start = buffer->line_starts[line];
+
+	if (buffer_is_line_plain(buffer, line)) {
+		return pos - line_start;
+	}
+	return buffer_advance_cells(buffer, line_start, pos, 0);
+}
+
+// the character covering a visual column of a line, or the end of the line when it is shorter,
+// lines past the end are clamped to the last
+u32 buffer_get_cell_position(Buffer *buffer, u32 line, u32 column) {
+	u32 line_start = buffer_get_line_start(buffer, line);
+	line = MIN(line, (u32) buffer->line_starts.length - 1);
+
+	if (buffer_is_line_plain(buffer, line)) {
+		return line_start + MIN(column, buffer_get_line_end(buffer, line) - line_start);
+	}
+	return buffer_find_cell(buffer, line_start, 0, column, 0);
+}
+
+// rows taken by a line, a line filling its last row exactly gets another one for the cursor after it
+static u32 buffer_count_line_rows(Buffer *buffer, u32 line_start) {
+	if (buffer->wrap_width == 0) return 1;
+
+	u32 cells = buffer_advance_cells(buffer, line_start, cursor_get_end_of_line(buffer, line_start), 0);
+	return cells / buffer->wrap_width + 1;
+}
+
+// width 0 turns wrapping off and every line is one row, any change drops the computed rows
+void buffer_set_wrap(Buffer *buffer, u32 width, u32 tab_width) {
+	if (buffer->wrap_width == width && buffer->tab_width == tab_width) return;
+
+	buffer->wrap_width = width;
+	buffer->tab_width = tab_width;
+	buffer->line_rows.resize(1);
+}
+
+// extends line_rows to hold line, false when the buffer has no such line
+static bool buffer_extend_rows(Buffer *buffer, u32 line) {
+	Array<u32> *line_rows = &buffer->line_rows;
+
+	while (line >= line_rows->length) {
+		u32 previous = (u32) line_rows->length - 1;
+		buffer_get_line_start(buffer, previous + 1);
+		if (buffer->line_starts.length <= previous + 1) {
+			return false;
+		}
+
+		line_rows->add(line_rows->data[previous] + buffer_count_line_rows(buffer, buffer->line_starts[previous]));
+	}
+
+	return true;
+}
+
+// first visual row of a line, lines past the end are clamped to the last
+u32 buffer_get_line_row(Buffer *buffer, u32 line) {
+	if (buffer->wrap_width == 0) {
+		return buffer_get_line_index(buffer, buffer_get_line_start(buffer, line));
+	}
+
+	if (!buffer_extend_rows(buffer, line)) {
+		line = (u32) buffer->line_rows.length - 1;
+	}
+	return buffer->line_rows[line];
+}
+
+// line holding a visual row, found by binary search over the computed rows
+u32 buffer_get_row_line(Buffer *buffer, u32 row) {
+	if (buffer->wrap_width == 0) {
+		return buffer_get_line_index(buffer, buffer_get_line_start(buffer, row));
+	}
+
+	Array<u32> *line_rows = &buffer->line_rows;
+	while (line_rows->data[line_rows->length - 1] <= row) {
+		if (!buffer_extend_rows(buffer, (u32) line_rows->length)) break;
+	}
+
+	s64 low = 0;
+	s64 high = line_rows->length - 1;
+	while (low < high) {
+		s64 middle = (low + high + 1) / 2;
+		if (line_rows->data[middle] <= row) {
+			low = middle;
+		} else {
+			high = middle - 1;
+		}
+	}
+
+	return (u32) low;
+}
+
+// visual row of pos, and the cell it starts at within that row when column is given
+u32 buffer_get_row(Buffer *buffer, u32 pos, u32 *column) {
+	u32 line = buffer_get_line_index(buffer, pos);
+	u32 row = buffer_get_line_row(buffer, line);
+
+	if (buffer->wrap_width == 0 && !column) return row;
+
+	u32 cells = buffer_advance_cells(buffer, buffer->line_starts[line], pos, 0);
+	if (buffer->wrap_width == 0) {
+		*column = cells;
+		return row;
+	}
+
+	if (column) {
+		*column = cells % buffer->wrap_width;
+	}
+	return row + cells / buffer->wrap_width;
+}
+
+// position at a cell column of a visual row, clamped to the end of its line
+u32 buffer_get_row_position(Buffer *buffer, u32 row, u32 column) {
+	u32 line = buffer_get_row_line(buffer, row);
+	u32 line_start = buffer_get_line_start(buffer, line);
+
+	u32 cell = column;
+	if (buffer->wrap_width > 0) {
+		u32 rows = buffer_count_line_rows(buffer, line_start);
+		u32 line_row = MIN(row - MIN(row, buffer->line_rows[line]), rows - 1);
+
+		// a column past the end of the row stays in the row instead of running into the next one
+		cell = MIN(column, buffer->wrap_width - 1) + line_row * buffer->wrap_width;
+	}
+
+	return buffer_find_cell(buffer, line_start, 0, cell, 0);
+}
+
+// the line break ending a line, or the end of the buffer for the last line
+u32 buffer_get_line_end(Buffer *buffer, u32 line) {
+	buffer_get_line_start(buffer, line + 1);
+	if (line + 1 < buffer->line_starts.length) {
+		return buffer->line_starts[line + 1] - 1;
+	}
+	return buffer_length(buffer);
+}
+
+// the corners are the cursor and the end of the selection, in whichever order they were made
+Block buffer_get_block(Buffer *buffer) {
+	u32 end = (s32)(buffer->cursor) + buffer->cursor_width;
+
+	u32 line = buffer_get_line_index(buffer, buffer->cursor);
+	u32 end_line = buffer_get_line_index(buffer, end);
+	u32 column = buffer_get_cell_column(buffer, buffer->cursor);
+	u32 end_column = buffer_get_cell_column(buffer, end);
+
+	Block block;
+	block.top = MIN(line, end_line);
+	block.bottom = MAX(line, end_line);
+	block.left = MIN(column, end_column);
+	block.right = MAX(column, end_column);
+	return block;
+}
+
+// the part of a line inside the block, empty when the line is too short to reach it,
+// a tab only partly inside is taken whole
+void buffer_get_block_range(Buffer *buffer, Block block, u32 line, u32 *from, u32 *to) {
+	u32 line_end = buffer_get_line_end(buffer, line);
+	u32 last = buffer_get_cell_position(buffer, line, block.right);
+
+	*from = buffer_get_cell_position(buffer, line, block.left);
+	*to = last < line_end ? cursor_next(buffer, last) : last;
+}
+
+// the part of each line inside the block as from, to pairs
+void buffer_get_block_ranges(Buffer *buffer, Block block, Array<u32> *ranges) {
+	ranges->reserve(2 * (block.bottom - block.top + 1));
+
+	for (u32 line = block.top; line <= block.bottom; ++line) {
+		u32 from, to;
+		buffer_get_block_range(buffer, block, line, &from, &to);
+
+		ranges->add(from);
+		ranges->add(to);
+	}
+}
+
 void buffer_goto_beginning(Buffer *buffer) {
 	buffer->cursor = 0;
 }
 
 void buffer_goto_next_line(Buffer *buffer) {
-	u32 column = cursor_get_column(buffer, buffer->cursor);
+	u32 column = buffer_get_cell_column(buffer, buffer->cursor);
 	u32 beginning_of_next_line = cursor_get_beginning_of_next_line(buffer, buffer->cursor);
-	u32 next_line_length = buffer_line_length(buffer, beginning_of_next_line);
 
-	buffer_set_cursor(buffer, beginning_of_next_line + MIN(next_line_length, column));
+	buffer_set_cursor(buffer, buffer_get_cell_position(buffer, buffer_get_line_index(buffer, beginning_of_next_line), column));
+}
+
+u32 buffer_count_codepoints(Buffer *buffer, u32 from, u32 to) {
+	u32 count = 0;
+
+	BufferSpan spans[2];
+	u32 span_count = buffer_get_spans(buffer, from, to, spans);
+	for (u32 i = 0; i < span_count; ++i) {
+		count += utf8_count_codepoints(spans[i].data, spans[i].length);
+	}
+
+	return count;
 }
 
 u32 cursor_next(Buffer *buffer, u32 cursor) {
 	buffer_asserts(buffer);
 
-	if (cursor < buffer_length(buffer)) {
+	u32 length = buffer_length(buffer);
+	if (cursor < length) {
 		cursor++;
+
+		while (cursor < length && UTF8_IS_CONTINUATION(buffer_get_char(buffer, cursor))) {
+			cursor++;
+		}
 	}
 
 	return cursor;
@@ -212,23 +941,39 @@ u32 cursor_back(Buffer *buffer, u32 cursor) {
 
 	if (cursor > 0) {
 		cursor--;
+
+		while (cursor > 0 && UTF8_IS_CONTINUATION(buffer_get_char(buffer, cursor))) {
+			cursor--;
+		}
+	}
+
+	return cursor;
+}
+
+u32 cursor_get_codepoint_start(Buffer *buffer, u32 cursor) {
+	while (cursor > 0 && cursor < buffer_length(buffer) &&
+			UTF8_IS_CONTINUATION(buffer_get_char(buffer, cursor))) {
+		cursor--;
 	}
 
 	return cursor;
 }
 
+/* '\n' is never part of a multi-byte sequence, so line scans can step bytes */
 u32 cursor_get_beginning_of_line(Buffer *buffer, u32 cursor) {
 	buffer_asserts(buffer);
 
-	cursor = cursor_back(buffer, cursor);
+	if (cursor > 0) {
+		cursor--;
+	}
 
 	while (cursor > 0) {
 		char ch = buffer_get_char(buffer, cursor);
 		if (ch == '\n') {
-			return cursor_next(buffer, cursor);
+			return cursor + 1;
 		}
 		
-		cursor = cursor_back(buffer, cursor);
+		cursor--;
 	}
 
 	return 0;
@@ -237,16 +982,7 @@ u32 cursor_get_beginning_of_line(Buffer *buffer, u32 cursor) {
 u32 cursor_get_end_of_line(Buffer *buffer, u32 cursor) {
 	buffer_asserts(buffer);
 
-	while (cursor < buffer_length(buffer)) {
-		char ch = buffer_get_char(buffer, cursor);
-		if (ch == '\n') {
-			return cursor;
-		}
-		
-		cursor = cursor_next(buffer, cursor);
-	}
-
-	return buffer_length(buffer);
+	return buffer_find_newline(buffer, cursor);
 }
 
 u32 cursor_get_beginning_of_next_line(Buffer *buffer, u32 cursor) {
@@ -269,11 +1005,12 @@ u32 buffer_line_length(Buffer *buffer, u32 cursor) {
 	return cursor_get_end_of_line(buffer, cursor) - cursor_get_beginning_of_line(buffer, cursor);
 }
 
-u32 cursor_get_column(Buffer *buffer, u32 cursor) {
-	return cursor - cursor_get_beginning_of_line(buffer, cursor);
-}
-
 u32 char_get_type(char c) {
+	// bytes of multi-byte sequences count as word characters
+	if ((u8) c >= 0x80) {
+		return 1;
+	}
+
 	if (isspace(c)) {
 		return 0;
 	}
@@ -312,7 +1049,7 @@ u32 cursor_get_end_of_word(Buffer *buffer, u32 cursor) {
 	}
 
 	if (current_type == 0) {
-		return cursor - 1;
+		return cursor_get_codepoint_start(buffer, cursor - 1);
 	}
 
 	return cursor;
@@ -350,7 +1087,7 @@ u32 cursor_get_prev_word(Buffer *buffer, u32 cursor) {
 	}
 
 	if (current_type == 0) {
-		return cursor - 1;
+		return cursor_get_codepoint_start(buffer, cursor - 1);
 	}
 
 	return cursor;
@@ -364,66 +1101,136 @@ Pane *pane_create(Editor *ed, Bounds bounds) {
 	pane->start = 0;
 	pane->end = UINT32_MAX;
 	pane->line_start = 0;
+	pane->row_offset = 0;
+	pane->column_offset = 0;
+	pane->anchor = 0;
+	pane->anchor_cell = 0;
+	pane->anchor_line = UINT32_MAX;
+	pane->anchor_version = 0;
 
 	ed->active_pane_index = ed->pane_count;
 	ed->current_buffer = pane->buffer;
 
+	// motions need the tab width before the first frame
+	pane_update_wrap(pane, &ed->settings);
+
 	ed->pane_count++;
 	return pane;
 }
 
-u32 get_line_difference(Buffer *buffer, u32 start, u32 end) {
-	u32 lines = 0;
-	
-	while (end > start) {
-		if (buffer_get_char(buffer, end) == '\n') {
-			lines++;
-		}
-		end = cursor_back(buffer, end);
+// line numbers and the space after them
+u32 pane_get_gutter_width(Pane *pane) {
+	char line_number[MAX_NUMBER_LENGTH];
+	return snprintf(line_number, sizeof(line_number), "%d", pane->line_start + pane->bounds.height - 1) + 1;
+}
+
+// lines wrap at the width left next to the line numbers
+void pane_update_wrap(Pane *pane, Settings *settings) {
+	u32 width = 0;
+	if (settings->soft_wrap) {
+		width = MAX(pane->bounds.width, pane_get_gutter_width(pane) + 1) - pane_get_gutter_width(pane);
 	}
 
-	if (cursor_get_end_of_line(buffer, buffer->cursor) == buffer_length(buffer)) {
-		lines++;
+	buffer_set_wrap(pane->buffer, width, MAX(settings->tab_width, 1u));
+}
+
+static bool pane_has_anchor(Pane *pane, u32 line) {
+	return pane->anchor_line == line && pane->anchor_version == pane->buffer->edit_version;
+}
+
+// the first character of a line at or past column_offset, and the cell it starts at
+u32 pane_get_visible_start(Pane *pane, u32 line, u32 *cell) {
+	Buffer *buffer = pane->buffer;
+
+	if (buffer->wrap_width == 0 && pane_has_anchor(pane, line)) {
+		*cell = pane->anchor_cell;
+		return pane->anchor;
 	}
 
-	return lines;
+	u32 column_offset = buffer->wrap_width == 0 ? pane->column_offset : 0;
+	return buffer_find_cell(buffer, buffer_get_line_start(buffer, line), 0, column_offset, cell);
 }
 
-void pane_update_scroll(Pane *pane) {
+// keeps the cursor column between column_offset and the right edge of the pane
+static void pane_update_horizontal_scroll(Pane *pane, u32 cursor) {
 	Buffer *buffer = pane->buffer;
-	u32 start = MIN(buffer_length(buffer), pane->start);
-	u32 end = MIN(buffer_length(buffer), pane->end);
 
-	u32 cursor = (s32)(buffer->cursor) + buffer->cursor_width;
+	if (buffer->wrap_width > 0) {
+		pane->column_offset = 0;
+		pane->anchor_line = UINT32_MAX;
+		return;
+	}
 
-	if (cursor < start) {
-		while (start > cursor) {
-			start = cursor_get_beginning_of_prev_line(buffer, start);
-		}
+	u32 line = buffer_get_line_index(buffer, cursor);
+
+	// counted on from the anchor, or back from it when no tab is in the way
+	u32 cursor_cell;
+	bool has_anchor = pane_has_anchor(pane, line);
+	if (has_anchor && cursor >= pane->anchor) {
+		cursor_cell = buffer_advance_cells(buffer, pane->anchor, cursor, pane->anchor_cell);
+	} else if (has_anchor && !buffer_has_tab(buffer, cursor, pane->anchor)) {
+		cursor_cell = pane->anchor_cell - buffer_count_codepoints(buffer, cursor, pane->anchor);
+	} else {
+		cursor_cell = buffer_get_cell_column(buffer, cursor);
+	}
 
-		u32 line_diff = get_line_difference(buffer, start, end);
-		while (line_diff > pane->bounds.height - 1) {
-			end = cursor_get_end_of_prev_line(buffer, end);
-			line_diff--;
-			pane->line_start--;
-		}
+	u32 text_width = MAX(pane->bounds.width, pane_get_gutter_width(pane) + 1) - pane_get_gutter_width(pane);
+	if (cursor_cell < pane->column_offset) {
+		pane->column_offset = cursor_cell;
+	} else if (cursor_cell >= pane->column_offset + text_width) {
+		pane->column_offset = cursor_cell - text_width + 1;
 	}
 
-	if (cursor > end) {
-		while (end < cursor) {
-			end = cursor_get_end_of_next_line(buffer, end);
+	// back from the cursor to the character covering column_offset, at most a pane width away,
+	// the width of a tab depends on what is before it so one on the way is found from the line start
+	u32 line_start = buffer_get_line_start(buffer, line);
+	u32 anchor = cursor;
+	u32 anchor_cell = cursor_cell;
+	while (anchor_cell > pane->column_offset && anchor > line_start) {
+		u32 previous = cursor_back(buffer, anchor);
+		if (buffer_get_char(buffer, previous) == '\t') {
+			anchor = buffer_find_cell(buffer, line_start, 0, pane->column_offset, &anchor_cell);
+			break;
 		}
 
-		u32 line_diff = get_line_difference(buffer, start, end);
-		while (line_diff > pane->bounds.height - 1) {
-			start = cursor_get_beginning_of_next_line(buffer, start);
-			line_diff--;
-			pane->line_start++;
-		}
+		anchor = previous;
+		anchor_cell--;
+	}
+
+	pane->anchor = anchor;
+	pane->anchor_cell = anchor_cell;
+	pane->anchor_line = line;
+	pane->anchor_version = buffer->edit_version;
+}
+
+// scrolls by visual rows so the end of the cursor stays between the top and the status line,
+// without wrapping every row is a line
+void pane_update_scroll(Pane *pane) {
+	PROFILE_SCOPE(PROFILE_SCROLL);
+
+	Buffer *buffer = pane->buffer;
+	u32 visible_rows = MAX(pane->bounds.height, 2u) - 1;
+
+	u32 cursor = (s32)(buffer->cursor) + buffer->cursor_width;
+	u32 cursor_row = buffer_get_row(buffer, MIN(cursor, buffer_length(buffer)), 0);
+
+	u32 top = buffer_get_line_row(buffer, pane->line_start) + pane->row_offset;
+	if (cursor_row < top) {
+		top = cursor_row;
+	} else if (cursor_row >= top + visible_rows) {
+		top = cursor_row - visible_rows + 1;
+	}
+
+	pane->line_start = buffer_get_row_line(buffer, top);
+	pane->row_offset = top - MIN(top, buffer_get_line_row(buffer, pane->line_start));
+
+	// rendering and highlighting start at the top row, not at the start of a long wrapped line
+	pane->start = buffer_get_line_start(buffer, pane->line_start);
+	if (pane->row_offset > 0) {
+		pane->start = buffer_get_row_position(buffer, top, 0);
 	}
 
-	pane->start = start;
-	pane->end = end;
+	pane_update_horizontal_scroll(pane, MIN(cursor, buffer_length(buffer)));
 }
 
 void pane_split_vertically(Editor *ed) {
@@ -15,10 +15,15 @@ static void command_execute(Editor *ed, char *command, char args[MAX_TOKENS][MAX
     
     if (strcmp(command, "w") == 0) {
         if (args_count > 0) {
+            // what was read can still be written somewhere else
+            if (!target_buffer->file_path || strcmp(target_buffer->file_path, args[0]) != 0) {
+                target_buffer->load_incomplete = false;
+            }
+
             free(target_buffer->file_path);
             target_buffer->file_path = strdup(args[0]);
         }
-        write_buffer_to_file(target_buffer);
+        buffer_save_async(target_buffer);
     } else if (strcmp(command, "find") == 0) {
         if (args_count > 0) {
             free(target_buffer->file_path);
@@ -27,6 +32,10 @@ static void command_execute(Editor *ed, char *command, char args[MAX_TOKENS][MAX
         read_file_to_buffer(target_buffer);
     } else if (strcmp(command, "q") == 0) {
         ed->running = false;
+    } else if (strcmp(command, "wrap") == 0) {
+        ed->settings.soft_wrap = true;
+    } else if (strcmp(command, "nowrap") == 0) {
+        ed->settings.soft_wrap = false;
     } else if (isdigit(command[0])) {
         u32 end = 0;
         while (isdigit(command[end])) {
@@ -42,10 +51,7 @@ static void command_execute(Editor *ed, char *command, char args[MAX_TOKENS][MAX
             number -= 1;
         }
 
-        buffer_goto_beginning(target_buffer);
-        for (u32 i = 0; i < number; ++i) {
-            buffer_goto_next_line(target_buffer);
-        }
+        buffer_set_cursor(target_buffer, buffer_get_line_start(target_buffer, number));
      }
 }
 
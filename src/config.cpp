@@ -0,0 +1,394 @@
+#include "shin.h"
+
+#include <stddef.h>
+
+#define SETTINGS_FILE "config"
+#define SETTINGS_VERSION 1
+
+// size of the binary config written before the text format
+#define SETTINGS_LEGACY_SIZE (COLOR_COUNT * sizeof(u32) + 3 * sizeof(u32) + 2 * sizeof(bool))
+
+#define SETTING_KEY_LENGTH 64
+#define SETTING_VALUE_LENGTH 64
+
+enum SettingType {
+	SETTING_COLOR,
+	SETTING_U32,
+	SETTING_F32,
+	SETTING_BOOL
+};
+
+struct SettingField {
+	const char *name;
+	SettingType type;
+	size_t offset;
+};
+
+#define SETTING_COLOR_FIELD(name, color) { name, SETTING_COLOR, offsetof(Settings, colors) + (color) * sizeof(u32) }
+
+// the config schema, also the order the file is written in
+static const SettingField setting_fields[] = {
+	SETTING_COLOR_FIELD("background_color", COLOR_BG),
+	SETTING_COLOR_FIELD("foreground_color", COLOR_FG),
+	SETTING_COLOR_FIELD("keyword_color", COLOR_KEYWORD),
+	SETTING_COLOR_FIELD("directive_color", COLOR_DIRECTIVE),
+	SETTING_COLOR_FIELD("number_color", COLOR_NUMBER),
+	SETTING_COLOR_FIELD("string_color", COLOR_STRING),
+	SETTING_COLOR_FIELD("type_color", COLOR_TYPE),
+	SETTING_COLOR_FIELD("comment_color", COLOR_COMMENT),
+	SETTING_COLOR_FIELD("selection_color", COLOR_SELECTION),
+	{ "tab_width", SETTING_U32, offsetof(Settings, tab_width) },
+	{ "font_size", SETTING_U32, offsetof(Settings, font_size) },
+	{ "opacity", SETTING_F32, offsetof(Settings, opacity) },
+	{ "vsync", SETTING_BOOL, offsetof(Settings, vsync) },
+	{ "hardware_rendering", SETTING_BOOL, offsetof(Settings, hardware_rendering) },
+	{ "soft_wrap", SETTING_BOOL, offsetof(Settings, soft_wrap) },
+};
+
+#define SETTING_FIELD_COUNT (sizeof(setting_fields) / sizeof(SettingField))
+
+void set_default_settings(Settings *settings) {
+	settings->colors[COLOR_BG] = 0x2A282A;
+	settings->colors[COLOR_FG] = 0xd6b48b;
+	settings->colors[COLOR_KEYWORD] = 0xffffff;
+	settings->colors[COLOR_DIRECTIVE] = 0xffffff;
+	settings->colors[COLOR_NUMBER] = 0x3bc4b9;
+	settings->colors[COLOR_STRING] = 0xC0B8B7;
+	settings->colors[COLOR_TYPE] = 0x8AC887;
+	settings->colors[COLOR_COMMENT] = 0xE6E249;
+	settings->colors[COLOR_SELECTION] = 0xf07a8e;
+
+	settings->dirty = false;
+
+	settings->tab_width = 4;
+	settings->font_size = 20;
+	settings->opacity = 1.0f;
+
+	settings->vsync = true;
+	settings->soft_wrap = false;
+
+#ifdef __APPLE__
+	settings->hardware_rendering = false;
+#else
+	settings->hardware_rendering	= true;
+#endif
+}
+
+static void settings_update_color_temps(Settings *settings) {
+	color_set_rgb_from_hex(settings->bg_temp, settings->colors[COLOR_BG]);
+	color_set_rgb_from_hex(settings->fg_temp, settings->colors[COLOR_FG]);
+	color_set_rgb_from_hex(settings->keyword_temp, settings->colors[COLOR_KEYWORD]);
+	color_set_rgb_from_hex(settings->directive_temp, settings->colors[COLOR_DIRECTIVE]);
+	color_set_rgb_from_hex(settings->number_temp, settings->colors[COLOR_NUMBER]);
+	color_set_rgb_from_hex(settings->string_temp, settings->colors[COLOR_STRING]);
+	color_set_rgb_from_hex(settings->type_temp, settings->colors[COLOR_TYPE]);
+	color_set_rgb_from_hex(settings->comment_temp, settings->colors[COLOR_COMMENT]);
+	color_set_rgb_from_hex(settings->selection_temp, settings->colors[COLOR_SELECTION]);
+}
+
+static bool settings_parse_value(Settings *settings, const SettingField *field, const char *value) {
+	u8 *target = (u8 *) settings + field->offset;
+	char *end;
+
+	switch (field->type) {
+	case SETTING_COLOR: {
+		if (value[0] == '#') value++;
+		u32 color = strtoul(value, &end, 16);
+		if (*end || end == value) return false;
+		*(u32 *) target = color & 0xFFFFFF;
+	} break;
+	case SETTING_U32: {
+		u32 number = strtoul(value, &end, 10);
+		if (*end || end == value) return false;
+		*(u32 *) target = number;
+	} break;
+	case SETTING_F32: {
+		f32 number = strtof(value, &end);
+		if (*end || end == value) return false;
+		*(f32 *) target = number;
+	} break;
+	case SETTING_BOOL: {
+		if (strcmp(value, "true") == 0 || strcmp(value, "1") == 0) {
+			*(bool *) target = true;
+		} else if (strcmp(value, "false") == 0 || strcmp(value, "0") == 0) {
+			*(bool *) target = false;
+		} else {
+			return false;
+		}
+	} break;
+	}
+
+	return true;
+}
+
+static void settings_apply(Settings *settings, u32 line, const char *key, const char *value) {
+	if (strcmp(key, "version") == 0) {
+		if ((u32) atoi(value) > SETTINGS_VERSION) {
+			fprintf(stderr, "%s:%u: version %s is newer than this build understands (%u)\n", SETTINGS_FILE, line, value, SETTINGS_VERSION);
+		}
+		return;
+	}
+
+	for (const SettingField &field : setting_fields) {
+		if (strcmp(field.name, key) == 0) {
+			if (!settings_parse_value(settings, &field, value)) {
+				fprintf(stderr, "%s:%u: invalid value '%s' for %s\n", SETTINGS_FILE, line, value, key);
+			}
+			return;
+		}
+	}
+
+	fprintf(stderr, "%s:%u: unknown setting '%s'\n", SETTINGS_FILE, line, key);
+}
+
+// single pass over "key = value" lines, '#' starts a comment line or a trailing comment
+static void settings_parse(Settings *settings, const char *text, u32 length) {
+	u32 pos = 0;
+	u32 line = 1;
+
+	while (pos < length) {
+		char key[SETTING_KEY_LENGTH];
+		char value[SETTING_VALUE_LENGTH];
+		u32 key_length = 0;
+		u32 value_length = 0;
+
+		while (pos < length && (text[pos] == ' ' || text[pos] == '\t' || text[pos] == '\r')) pos++;
+
+		while (pos < length && (isalnum((u8) text[pos]) || text[pos] == '_')) {
+			if (key_length < SETTING_KEY_LENGTH - 1) key[key_length++] = text[pos];
+			pos++;
+		}
+		key[key_length] = 0;
+
+		while (pos < length && (text[pos] == ' ' || text[pos] == '\t')) pos++;
+
+		bool has_value = pos < length && text[pos] == '=';
+		if (has_value) {
+			pos++;
+			while (pos < length && (text[pos] == ' ' || text[pos] == '\t')) pos++;
+
+			// a '#' after whitespace starts a comment, a leading one is part of a color
+			while (pos < length && text[pos] != '\n') {
+				if (text[pos] == '#' && value_length > 0 && isspace((u8) text[pos - 1])) break;
+				if (value_length < SETTING_VALUE_LENGTH - 1) value[value_length++] = text[pos];
+				pos++;
+			}
+			while (value_length > 0 && isspace((u8) value[value_length - 1])) value_length--;
+		}
+		value[value_length] = 0;
+
+		bool is_blank = key_length == 0 && (pos >= length || text[pos] == '\n' || text[pos] == '#');
+		if (key_length > 0 && has_value) {
+			settings_apply(settings, line, key, value);
+		} else if (!is_blank) {
+			fprintf(stderr, "%s:%u: expected 'key = value'\n", SETTINGS_FILE, line);
+		}
+
+		while (pos < length && text[pos] != '\n') pos++;
+		pos++;
+		line++;
+	}
+}
+
+static void settings_parse_legacy(Settings *settings, const char *data) {
+	memcpy(settings->colors, data, sizeof(u32) * COLOR_COUNT);
+	data += sizeof(u32) * COLOR_COUNT;
+	memcpy(&settings->tab_width, data, sizeof(u32));
+	memcpy(&settings->font_size, data + sizeof(u32), sizeof(u32));
+	memcpy(&settings->opacity, data + 2 * sizeof(u32), sizeof(f32));
+	memcpy(&settings->vsync, data + 3 * sizeof(u32), sizeof(bool));
+	memcpy(&settings->hardware_rendering, data + 3 * sizeof(u32) + sizeof(bool), sizeof(bool));
+}
+
+static bool settings_is_legacy(const char *text, u32 length) {
+	return length == SETTINGS_LEGACY_SIZE && memchr(text, 0, length);
+}
+
+static char *settings_read_file(u32 *length) {
+	FILE *f = fopen(SETTINGS_FILE, "rb");
+	if (!f) {
+		return 0;
+	}
+
+	fseek(f, 0, SEEK_END);
+	*length = ftell(f);
+	fseek(f, 0, SEEK_SET);
+
+	char *text = (char *) malloc(*length + 1);
+	*length = fread(text, 1, *length, f);
+	text[*length] = 0;
+	fclose(f);
+
+	return text;
+}
+
+static bool settings_load_file(Settings *settings) {
+	u32 length;
+	char *text = settings_read_file(&length);
+	if (!text) {
+		return false;
+	}
+
+	// the old binary config is read once and rewritten as text on exit
+	if (settings_is_legacy(text, length)) {
+		settings_parse_legacy(settings, text);
+		settings->dirty = true;
+	} else {
+		settings_parse(settings, text, length);
+	}
+
+	// a bad value must not ask the glyph map for an enormous font
+	settings->font_size = MIN(MAX(settings->font_size, 1u), (u32) MAX_FONT_SIZE);
+
+	free(text);
+	return true;
+}
+
+void load_settings_file_or_set_default(Settings *settings) {
+	set_default_settings(settings);
+
+	// write the defaults out so there is a file to edit
+	if (!settings_load_file(settings)) {
+		save_settings(settings);
+	}
+
+	settings_update_color_temps(settings);
+
+	settings->last_hardware_rendering = settings->hardware_rendering;
+}
+
+static void settings_write_value(FILE *f, const SettingField *field, Settings *settings) {
+	u8 *source = (u8 *) settings + field->offset;
+
+	switch (field->type) {
+	case SETTING_COLOR: fprintf(f, "#%06X", *(u32 *) source); break;
+	case SETTING_U32: fprintf(f, "%u", *(u32 *) source); break;
+	case SETTING_F32: fprintf(f, "%g", *(f32 *) source); break;
+	case SETTING_BOOL: fprintf(f, "%s", *(bool *) source ? "true" : "false"); break;
+	}
+}
+
+// finds the schema field a "key = value" line sets and where its value is, the same way settings_parse reads it
+static s32 settings_find_line_value(const char *text, u32 pos, u32 end, u32 *value_start, u32 *value_end) {
+	while (pos < end && (text[pos] == ' ' || text[pos] == '\t' || text[pos] == '\r')) pos++;
+
+	u32 key_start = pos;
+	while (pos < end && (isalnum((u8) text[pos]) || text[pos] == '_')) pos++;
+	u32 key_length = pos - key_start;
+
+	while (pos < end && (text[pos] == ' ' || text[pos] == '\t')) pos++;
+	if (key_length == 0 || pos >= end || text[pos] != '=') return -1;
+
+	pos++;
+	while (pos < end && (text[pos] == ' ' || text[pos] == '\t')) pos++;
+
+	*value_start = pos;
+	while (pos < end && !(text[pos] == '#' && pos > *value_start && isspace((u8) text[pos - 1]))) pos++;
+	while (pos > *value_start && isspace((u8) text[pos - 1])) pos--;
+	*value_end = pos;
+
+	for (u32 i = 0; i < SETTING_FIELD_COUNT; ++i) {
+		const char *name = setting_fields[i].name;
+		if (strlen(name) == key_length && memcmp(name, text + key_start, key_length) == 0) return (s32) i;
+	}
+
+	return -1;
+}
+
+// an existing text config keeps its comments, order and unknown keys, only known values are replaced
+void save_settings(Settings *settings) {
+	u32 length = 0;
+	char *text = settings_read_file(&length);
+	if (text && settings_is_legacy(text, length)) {
+		free(text);
+		text = 0;
+		length = 0;
+	}
+
+	FILE *f = fopen(SETTINGS_FILE, "wb");
+	if (!f) {
+		free(text);
+		return;
+	}
+
+	if (!text) {
+		fprintf(f, "# shin config, changes are applied while the editor is running\n");
+		fprintf(f, "version = %u\n\n", SETTINGS_VERSION);
+	}
+
+	bool written[SETTING_FIELD_COUNT] = {};
+
+	for (u32 pos = 0; pos < length;) {
+		u32 end = pos;
+		while (end < length && text[end] != '\n') end++;
+
+		u32 value_start, value_end;
+		s32 index = settings_find_line_value(text, pos, end, &value_start, &value_end);
+		if (index >= 0) {
+			fwrite(text + pos, 1, value_start - pos, f);
+			settings_write_value(f, &setting_fields[index], settings);
+			fwrite(text + value_end, 1, end - value_end, f);
+			written[index] = true;
+		} else {
+			fwrite(text + pos, 1, end - pos, f);
+		}
+
+		if (end < length) fputc('\n', f);
+		pos = end + 1;
+	}
+
+	if (length > 0 && text[length - 1] != '\n') fputc('\n', f);
+
+	// a key the file leaves out is only added once it differs from the default
+	Settings defaults;
+	set_default_settings(&defaults);
+
+	for (u32 i = 0; i < SETTING_FIELD_COUNT; ++i) {
+		size_t offset = setting_fields[i].offset;
+		size_t size = setting_fields[i].type == SETTING_BOOL ? sizeof(bool) : sizeof(u32);
+		bool is_default = memcmp((u8 *) settings + offset, (u8 *) &defaults + offset, size) == 0;
+		if (written[i] || (text && is_default)) continue;
+
+		fprintf(f, "%s = ", setting_fields[i].name);
+		settings_write_value(f, &setting_fields[i], settings);
+		fputc('\n', f);
+	}
+
+	fclose(f);
+	free(text);
+	settings->dirty = false;
+}
+
+void settings_reload(Editor *ed) {
+	Settings *settings = &ed->settings;
+
+	Settings loaded = *settings;
+	set_default_settings(&loaded);
+	if (!settings_load_file(&loaded)) {
+		return;
+	}
+
+	bool colors_changed = memcmp(loaded.colors, settings->colors, sizeof(settings->colors)) != 0;
+	bool window_changed = loaded.vsync != settings->vsync || loaded.opacity != settings->opacity;
+
+	memcpy(settings->colors, loaded.colors, sizeof(settings->colors));
+	settings->tab_width = loaded.tab_width;
+	settings->opacity = loaded.opacity;
+	settings->vsync = loaded.vsync;
+	settings->soft_wrap = loaded.soft_wrap;
+
+	// the main loop rebuilds the glyph map when the size differs from the requested one
+	settings->font_size = loaded.font_size;
+
+	if (colors_changed) {
+		settings_update_color_temps(settings);
+	}
+
+	if (colors_changed || window_changed) {
+		ed->renderer->query_settings(settings);
+	}
+}
+
+const char *settings_file_path() {
+	return SETTINGS_FILE;
+}
@@ -0,0 +1,437 @@
+#include "shin.h"
+
+char *read_entire_file(const char *file_path) {
+	FILE *file = fopen(file_path, "rb");
+	if (!file) {
+		return 0;
+	}
+
+	fseek(file, 0, SEEK_END);
+	size_t length = ftell(file);
+	fseek(file, 0, SEEK_SET);
+
+	char *contents = (char *) malloc(length + 1);
+	fread(contents, 1, length, file);
+	contents[length] = 0;
+
+	return contents;
+}
+
+u32 color_hex_from_rgb(f32 rgb[3]) {
+	u32 r = (u32)(rgb[0] * 255.0f) << 16;
+	u32 g = (u32)(rgb[1] * 255.0f) << 8;
+	u32 b = (u32)(rgb[2] * 255.0f);
+	return r | g | b;
+}
+
+void color_set_rgb_from_hex(f32 rgb[3], u32 hex) {
+	u32 r = (hex >> 16) & 0xFF;
+	u32 g = (hex >> 8) & 0xFF;
+	u32 b = hex & 0xFF;
+	rgb[0] = r / 255.0f;
+	rgb[1] = g / 255.0f;
+	rgb[2] = b / 255.0f;
+}
+
+u32 color_invert(u32 c) {
+	return 0xFFFFFFFF - c;
+}
+
+static u32 bounds_scale_coordinate(u32 value, u32 from, u32 to) {
+	return (u32) ((u64) value * to / MAX(from, 1u));
+}
+
+Bounds bounds_scale(Bounds bounds, u32 from_columns, u32 from_rows, u32 to_columns, u32 to_rows) {
+	Bounds scaled;
+	scaled.left = bounds_scale_coordinate(bounds.left, from_columns, to_columns);
+	scaled.top = bounds_scale_coordinate(bounds.top, from_rows, to_rows);
+	scaled.width = bounds_scale_coordinate(bounds.left + bounds.width, from_columns, to_columns) - scaled.left;
+	scaled.height = bounds_scale_coordinate(bounds.top + bounds.height, from_rows, to_rows) - scaled.top;
+	return scaled;
+}
+
+void draw_buffer_resize(Editor *ed, DrawBuffer *buffer, GlyphMap *glyph_map, s32 width, s32 height) {
+	FontMetrics metrics = glyph_map->metrics;
+
+	u32 old_columns = buffer->columns;
+	u32 old_rows = buffer->rows - 1;
+
+	buffer->columns = floor((f32)width / metrics.glyph_width);
+	buffer->rows = floor((f32)height / metrics.glyph_height);
+	buffer->cells_size = sizeof(Cell) * buffer->columns * buffer->rows;
+	buffer->cells = (Cell *) realloc(buffer->cells, buffer->cells_size);
+
+	// split layouts keep their proportions, a single pane fills the window
+	if (ed->pane_count > 1) {
+		for (u32 i = 0; i < ed->pane_count; ++i) {
+			Bounds *bounds = &ed->pane_pool[i].bounds;
+			*bounds = bounds_scale(*bounds, old_columns, old_rows, buffer->columns, buffer->rows - 1);
+		}
+		return;
+	}
+
+	Bounds *bounds = &ed->pane_pool[ed->active_pane_index].bounds;
+	bounds->left = 0;
+	bounds->top = 0;
+	bounds->width = buffer->columns;
+	bounds->height = buffer->rows - 1;
+}
+
+void draw_buffer_init(DrawBuffer *buffer) {
+	buffer->cells = (Cell *) malloc(buffer->cells_size);
+	memset(buffer->cells, 0, buffer->cells_size);
+}
+
+// what a pane draws text with, the style of a position depends on nothing else
+struct RenderState {
+	Pane *pane;
+	bool is_active_pane;
+	bool is_visual;
+
+	// inclusive, a block selection sets these for each line, empty when start > end
+	u32 selection_start;
+	u32 selection_end;
+
+	// highlights and extra cursors are sorted, these walk them along with the text
+	u32 highlight_index;
+	u32 extra_cursor;
+};
+
+// the colors of a run of characters, the style only changes again at until
+struct RenderRun {
+	u8 foreground;
+	u8 background;
+	u8 glyph_flags;
+	bool has_cursor;
+	u32 until;
+};
+
+static RenderRun render_get_run(RenderState *state, u32 pos) {
+	Array<Highlight> *highlights = &state->pane->highlights;
+	Array<u32> *cursors = &state->pane->buffer->cursors;
+
+	RenderRun run = {COLOR_FG, COLOR_BG, 0, false, UINT32_MAX};
+
+	while (state->highlight_index < highlights->length && (*highlights)[state->highlight_index].end < pos) {
+		state->highlight_index++;
+	}
+	if (state->highlight_index < highlights->length) {
+		Highlight highlight = (*highlights)[state->highlight_index];
+		if (highlight.start <= pos) {
+			run.foreground = (u8) highlight.color_index;
+			run.until = highlight.end + 1;
+		} else {
+			run.until = highlight.start;
+		}
+	}
+
+	if (!state->is_active_pane) return run;
+
+	// cursor / visual mode selection
+	if (state->selection_start <= pos && pos <= state->selection_end) {
+		if (state->is_visual) {
+			run.background = COLOR_SELECTION;
+		} else {
+			run.glyph_flags |= GLYPH_INVERT;
+		}
+		run.has_cursor = true;
+		run.until = MIN(run.until, state->selection_end + 1);
+	} else if (pos < state->selection_start) {
+		run.until = MIN(run.until, state->selection_start);
+	}
+
+	while (state->extra_cursor < cursors->length && (*cursors)[state->extra_cursor] < pos) {
+		state->extra_cursor++;
+	}
+	if (state->extra_cursor < cursors->length) {
+		u32 cursor = (*cursors)[state->extra_cursor];
+		if (cursor == pos) {
+			run.glyph_flags |= GLYPH_INVERT;
+			run.until = MIN(run.until, pos + 1);
+		} else {
+			run.until = MIN(run.until, cursor);
+		}
+	}
+
+	return run;
+}
+
+void render_pane(Editor *ed, DrawBuffer *draw_buffer, Pane *pane, bool is_active_pane) {
+	PROFILE_SCOPE(PROFILE_RENDER_PANE);
+
+	Buffer *buffer = pane->buffer;
+	Bounds bounds = pane->bounds;
+	Settings *settings = &ed->settings;
+
+	pane_update_wrap(pane, settings);
+
+	u32 start = pane->start;
+	u32 length = buffer_length(buffer);
+	u32 rows_drawn = 0;
+	u32 pos;
+
+	bool has_drawn_cursor = false;
+
+	RenderState state = {0};
+	state.pane = pane;
+	state.is_active_pane = is_active_pane;
+	state.is_visual = buffer->mode == MODE_VISUAL || buffer->mode == MODE_VISUAL_BLOCK;
+	state.selection_start = MIN(buffer->cursor, buffer->cursor + buffer->cursor_width);
+	state.selection_end = MAX(buffer->cursor, buffer->cursor + buffer->cursor_width);
+	while (state.extra_cursor < buffer->cursors.length && buffer->cursors[state.extra_cursor] < start) {
+		state.extra_cursor++;
+	}
+
+	// a block selection is made of visual columns, turned into a range of positions on each line
+	bool is_block = buffer->mode == MODE_VISUAL_BLOCK && is_active_pane;
+	Block block = {0};
+	if (is_block) {
+		block = buffer_get_block(buffer);
+	}
+
+	char line_number_buffer[MAX_NUMBER_LENGTH];
+	u32 max_line_number_length = pane_get_gutter_width(pane) - 1;
+
+	u32 text_left = bounds.left + max_line_number_length + 1;
+	u32 text_right = MIN(bounds.left + bounds.width, draw_buffer->columns);
+	u32 text_width = text_right > text_left ? text_right - text_left : 0;
+	u32 text_rows = bounds.height - 1;
+	u32 tab_width = buffer->tab_width;
+
+	// with wrapping the cells of a line flow over rows of wrap_width, without it they are cut at the pane edge
+	u32 wrap_width = buffer->wrap_width;
+	s32 row_width = (s32) (wrap_width ? wrap_width : text_width);
+	u32 column_offset = wrap_width ? 0 : pane->column_offset;
+	u32 skip_rows = pane->row_offset;
+	u32 end = start;
+	bool is_full = false;
+
+	u32 line_index = pane->line_start;
+	for (pos = start; pos < length && rows_drawn < text_rows; pos = cursor_next(buffer, pos), line_index++) {
+		u32 line_top = rows_drawn;
+		u32 line_end = buffer_get_line_end(buffer, line_index);
+		u32 cell_index = 0;
+
+		if (!wrap_width) {
+			// a line scrolled sideways is drawn from its first visible character
+			pos = pane_get_visible_start(pane, line_index, &cell_index);
+		} else if (pos == start && skip_rows > 0) {
+			// the top of the pane can be partway through a wrapped line
+			cell_index = buffer_advance_cells(buffer, buffer_get_line_start(buffer, line_index), pos, 0);
+		}
+
+		if (is_block) {
+			state.selection_start = UINT32_MAX;
+			state.selection_end = 0;
+
+			if (block.top <= line_index && line_index <= block.bottom) {
+				u32 from, to;
+				buffer_get_block_range(buffer, block, line_index, &from, &to);
+				if (from < to) {
+					state.selection_start = from;
+					state.selection_end = to - 1;
+				}
+			}
+		}
+
+		// display line number on the first row of the line
+		if (skip_rows == 0) {
+			snprintf(line_number_buffer, sizeof(line_number_buffer), "%d", line_index + 1);
+			u32 line_number_length = strlen(line_number_buffer);
+
+			u32 line_number_offset = max_line_number_length - line_number_length;
+			for (u32 j = 0; j < line_number_length; ++j) {
+				Cell *cell = &draw_buffer->cells[line_number_offset + j + (bounds.top + line_top) * draw_buffer->columns];
+				cell->glyph_index = line_number_buffer[j] - 32;
+				cell->background = COLOR_BG;
+				cell->foreground = COLOR_FG;
+				cell->glyph_flags = 0;
+			}
+		}
+
+		// x is the cell in the row, a character partly scrolled off to the left starts before it
+		s32 x = wrap_width ? (s32) (cell_index % wrap_width) : (s32) cell_index - (s32) column_offset;
+		u32 row = wrap_width ? cell_index / wrap_width : 0;
+		Cell *row_cells = row >= skip_rows ? &draw_buffer->cells[text_left + (bounds.top + line_top + row - skip_rows) * draw_buffer->columns] : 0;
+
+		RenderRun run = {0};
+		bool is_done = false;
+
+		// buffer rendering, straight from the memory on each side of the gap
+		BufferSpan spans[2];
+		u32 span_count = buffer_get_spans(buffer, pos, line_end, spans);
+		for (u32 i = 0; i < span_count && !is_done; ++i) {
+			const u8 *text = (const u8 *) spans[i].data;
+			const u8 *text_end = text + spans[i].length;
+
+			for (const u8 *c = text; c < text_end && !is_done;) {
+				u32 char_pos = spans[i].pos + (u32) (c - text);
+				if (char_pos >= run.until) {
+					run = render_get_run(&state, char_pos);
+				}
+
+				// every character up to the end of the run is drawn with its colors
+				const u8 *run_end = text + MIN((u64) run.until - spans[i].pos, (u64) spans[i].length);
+				for (; c < run_end; ++c) {
+					u8 ch = *c;
+
+					// continuation bytes share the cell of their leading byte
+					if (UTF8_IS_CONTINUATION(ch)) continue;
+
+					if (x >= row_width) {
+						if (!wrap_width) {
+							// the rest of the line is off to the right
+							is_done = true;
+							break;
+						}
+
+						// a tab can run past the end of the row, the next character starts the row after
+						while (x >= row_width) {
+							x -= row_width;
+							row++;
+						}
+						if (row >= skip_rows + text_rows - line_top) {
+							pos = spans[i].pos + (u32) (c - text);
+							is_full = true;
+							is_done = true;
+							break;
+						}
+						row_cells = row >= skip_rows ? &draw_buffer->cells[text_left + (bounds.top + line_top + row - skip_rows) * draw_buffer->columns] : 0;
+					}
+
+					// a tab runs to the next tab stop of the line, which can be past the end of the row
+					u32 cells = ch == '\t' ? tab_width - cell_index % tab_width : 1;
+
+					if (row_cells && x >= 0 && (u32) x < text_width) {
+						// the glyph map only holds ascii, other codepoints are drawn as '?' and control characters have no glyph
+						Cell *cell = &row_cells[x];
+						cell->glyph_index = ch >= 0x80 ? '?' - 32 : ch < ' ' ? 0 : ch - 32;
+						cell->background = run.background;
+						cell->foreground = run.foreground;
+						cell->glyph_flags = run.glyph_flags;
+						has_drawn_cursor |= run.has_cursor;
+
+						// the rest of a tab is background, up to the end of the row
+						for (u32 k = 1; k < cells && (u32) x + k < text_width && (s32) (x + k) < row_width; ++k) {
+							row_cells[x + k].background = run.background;
+						}
+					}
+
+					x += cells;
+					cell_index += cells;
+				}
+			}
+		}
+
+		if (is_full) {
+			rows_drawn = text_rows;
+			break;
+		}
+		pos = line_end;
+
+		// the end of the line holds the cursor when it is after the last character
+		while (wrap_width && x >= row_width) {
+			x -= row_width;
+			row++;
+		}
+		u32 line_rows = row + 1;
+		u32 end_row = line_top + row - MIN(skip_rows, row);
+		bool end_is_visible = row >= skip_rows && end_row < text_rows && x >= 0 && (u32) x < text_width;
+		Cell *end_cell = &draw_buffer->cells[text_left + MAX(x, 0) + (bounds.top + end_row) * draw_buffer->columns];
+
+		if (!has_drawn_cursor && pos == buffer->cursor && is_active_pane && end_is_visible) {
+			end_cell->glyph_flags = GLYPH_INVERT;
+			has_drawn_cursor = true;
+		}
+
+		// extra cursors at the end of the line, or in the part of it that was cut off
+		while (state.extra_cursor < buffer->cursors.length && buffer->cursors[state.extra_cursor] <= pos) {
+			if (buffer->cursors[state.extra_cursor] == pos && is_active_pane && end_is_visible) {
+				end_cell->glyph_flags = GLYPH_INVERT;
+			}
+			state.extra_cursor++;
+		}
+
+		rows_drawn = MIN(line_top + line_rows - MIN(skip_rows, line_rows - 1), text_rows);
+		skip_rows = 0;
+		end = pos;
+	}
+
+	if (is_active_pane && !has_drawn_cursor && rows_drawn < text_rows) {
+		draw_buffer->cells[text_left + (bounds.top + rows_drawn) * draw_buffer->columns].glyph_flags = GLYPH_INVERT;
+	}
+
+	pane->end = is_full ? pos : end;
+
+	// render status
+	/* TODO: maybe not call this! */
+	const char *mode_string = "NORMAL";
+	if (buffer->mode == MODE_INSERT) {
+		mode_string = "INSERT";
+	} else if (buffer->mode == MODE_VISUAL) {
+		mode_string = "VISUAL";
+	} else if (buffer->mode == MODE_VISUAL_BLOCK) {
+		mode_string = "VISUAL BLOCK";
+	}
+
+	char macro_register;
+	char mode_recording[32];
+	if (macro_get_recording(&macro_register)) {
+		snprintf(mode_recording, sizeof(mode_recording), "%s recording @%c", mode_string, macro_register);
+		mode_string = mode_recording;
+	}
+
+	u32 percent;
+	if (load_get_progress(buffer, &percent)) {
+		snprintf(pane->status, MAX_STATUS_LENGTH, "%s %s [loading %u%%]", mode_string, buffer->file_path, percent);
+	} else if (save_get_progress(buffer, &percent)) {
+		snprintf(pane->status, MAX_STATUS_LENGTH, "%s %s [saving %u%%]", mode_string, buffer->file_path, percent);
+	} else if (buffer->changed_on_disk) {
+		snprintf(pane->status, MAX_STATUS_LENGTH, "%s %s [changed on disk]", mode_string, buffer->file_path);
+	} else {
+		snprintf(pane->status, MAX_STATUS_LENGTH, "%s %s", mode_string, buffer->file_path);
+	}
+
+	u32 status_start = bounds.left + (bounds.top + bounds.height - 1) * draw_buffer->columns;
+	u32 status_length = strlen(pane->status);
+	for (u32 i = 0; i < MIN(draw_buffer->columns, bounds.width); ++i) {
+		Cell *cell = &draw_buffer->cells[status_start + i];
+
+		if (i < status_length) {
+			cell->glyph_index = pane->status[i] - 32;
+		}
+		cell->background = COLOR_BG;
+		cell->foreground = COLOR_FG;
+		cell->glyph_flags = GLYPH_INVERT;
+	}
+}
+
+void render(Editor *ed, DrawBuffer *draw_buffer) {
+
+	memset(draw_buffer->cells, 0, draw_buffer->cells_size);
+
+	Pane *active_pane = &ed->pane_pool[ed->active_pane_index];
+	pane_update_wrap(active_pane, &ed->settings);
+	pane_update_scroll(active_pane);
+	highlighting_parse(active_pane);
+
+	for (u32 i = 0; i < ed->pane_count; ++i) {
+		Pane *pane = &ed->pane_pool[i];
+
+		render_pane(ed, draw_buffer, pane, i == ed->active_pane_index);
+	}
+
+	// command textbox
+	if (ed->current_buffer->mode == MODE_COMMAND) {
+		u32 start = (draw_buffer->rows - 1) * draw_buffer->columns;
+		for (u32 i = 0; i < MIN(command_get_cursor(), draw_buffer->columns); ++i) {
+			Cell *cell = &draw_buffer->cells[start + i];
+
+			cell->glyph_index = command_buffer_get(i) - 32;
+			cell->background = COLOR_BG;
+			cell->foreground = COLOR_FG;
+			cell->glyph_flags = 0;
+		}
+		draw_buffer->cells[start + command_get_cursor()].glyph_flags |= GLYPH_INVERT;
+	}
+}
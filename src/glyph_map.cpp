@@ -3,7 +3,214 @@
 #include <ft2build.h>
 #include FT_FREETYPE_H
 
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <direct.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define GLYPH_CACHE_DIRECTORY "cache"
+#define GLYPH_CACHE_MAGIC 0x43474853 /* "SHGC" */
+#define GLYPH_CACHE_VERSION 1
+#define GLYPH_RENDER_MODE FT_RENDER_MODE_NORMAL
+
 static FT_Library library;
+static bool library_initialized = false;
+
+// every atlas ever built stays cached so zooming back is instant
+static std::mutex glyph_maps_mutex;
+static Array<GlyphMap *> glyph_maps;
+
+static const char *zoom_font;
+static u32 zoom_pixel_size = 0;
+static bool zoom_building = false;
+static std::atomic<GlyphMap *> zoom_ready;
+
+struct GlyphCacheHeader {
+	u32 magic;
+	u32 version;
+	u64 font_hash;
+	u32 pixel_size;
+	u32 render_mode;
+	FontMetrics metrics;
+	u32 width;
+	u32 height;
+};
+
+static u64 font_file_hash(const char *font) {
+	FILE *file = fopen(font, "rb");
+	if (!file) {
+		return 0;
+	}
+
+	// FNV-1a
+	u64 hash = 0xcbf29ce484222325ULL;
+	u8 chunk[64 * 1024];
+	u64 size_read;
+	while ((size_read = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+		for (u64 i = 0; i < size_read; ++i) {
+			hash ^= chunk[i];
+			hash *= 0x100000001b3ULL;
+		}
+	}
+
+	fclose(file);
+	return hash;
+}
+
+static void glyph_cache_get_path(char *path, u32 path_size, u64 font_hash, u32 pixel_size) {
+	snprintf(path, path_size, "%s/glyphs_%016llx_%u_%u.bin", GLYPH_CACHE_DIRECTORY,
+			 (unsigned long long) font_hash, pixel_size, (u32) GLYPH_RENDER_MODE);
+}
+
+static void *file_map_read_only(const char *path, u64 *size) {
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+	if (file == INVALID_HANDLE_VALUE) {
+		return 0;
+	}
+
+	LARGE_INTEGER file_size;
+	GetFileSizeEx(file, &file_size);
+
+	HANDLE mapping = CreateFileMappingA(file, 0, PAGE_READONLY, 0, 0, 0);
+	CloseHandle(file);
+	if (!mapping) {
+		return 0;
+	}
+
+	void *data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(mapping);
+
+	*size = file_size.QuadPart;
+	return data;
+#else
+	s32 fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		return 0;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0) {
+		close(fd);
+		return 0;
+	}
+
+	void *data = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED) {
+		return 0;
+	}
+
+	*size = st.st_size;
+	return data;
+#endif
+}
+
+static void file_unmap(void *data, u64 size) {
+#ifdef _WIN32
+	UnmapViewOfFile(data);
+#else
+	munmap(data, size);
+#endif
+}
+
+static GlyphMap *glyph_cache_load(u64 font_hash, u32 pixel_size) {
+	char path[256];
+	glyph_cache_get_path(path, sizeof(path), font_hash, pixel_size);
+
+	u64 size;
+	u8 *data = (u8 *) file_map_read_only(path, &size);
+	if (!data) {
+		return 0;
+	}
+
+	GlyphCacheHeader header;
+	memcpy(&header, data, MIN(size, sizeof(header)));
+
+	bool valid = size >= sizeof(header) &&
+		header.magic == GLYPH_CACHE_MAGIC &&
+		header.version == GLYPH_CACHE_VERSION &&
+		header.font_hash == font_hash &&
+		header.pixel_size == pixel_size &&
+		header.render_mode == GLYPH_RENDER_MODE &&
+		size == sizeof(header) + (u64) header.width * header.height;
+
+	if (!valid) {
+		file_unmap(data, size);
+		return 0;
+	}
+
+	GlyphMap *map = (GlyphMap *) malloc(sizeof(GlyphMap));
+	map->metrics = header.metrics;
+	map->pixel_size = pixel_size;
+	map->width = header.width;
+	map->height = header.height;
+	map->data = data + sizeof(header);
+
+	return map;
+}
+
+static void glyph_cache_store(GlyphMap *map, u64 font_hash, u32 pixel_size) {
+	char path[256];
+	glyph_cache_get_path(path, sizeof(path), font_hash, pixel_size);
+
+	// other instances may have the old cache mapped, so it is replaced by a rename and never truncated
+	char temp_path[256 + 16];
+#ifdef _WIN32
+	snprintf(temp_path, sizeof(temp_path), "%s.%lu.tmp", path, (unsigned long) GetCurrentProcessId());
+	FILE *file = fopen(temp_path, "wb");
+#else
+	snprintf(temp_path, sizeof(temp_path), "%s.XXXXXX", path);
+	s32 fd = mkstemp(temp_path);
+	if (fd >= 0) {
+		// mkstemp makes the file private, the cache is as readable as a file created normally
+		mode_t mask = umask(0);
+		umask(mask);
+		fchmod(fd, 0666 & ~mask);
+	}
+	FILE *file = fd >= 0 ? fdopen(fd, "wb") : 0;
+	if (fd >= 0 && !file) {
+		close(fd);
+		unlink(temp_path);
+	}
+#endif
+	if (!file) {
+		return;
+	}
+
+	GlyphCacheHeader header = {0};
+	header.magic = GLYPH_CACHE_MAGIC;
+	header.version = GLYPH_CACHE_VERSION;
+	header.font_hash = font_hash;
+	header.pixel_size = pixel_size;
+	header.render_mode = GLYPH_RENDER_MODE;
+	header.metrics = map->metrics;
+	header.width = map->width;
+	header.height = map->height;
+
+	bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+	ok = ok && fwrite(map->data, 1, map->width * map->height, file) == map->width * map->height;
+	ok = fclose(file) == 0 && ok;
+
+#ifdef _WIN32
+	ok = ok && MoveFileExA(temp_path, path, MOVEFILE_REPLACE_EXISTING);
+#else
+	ok = ok && rename(temp_path, path) == 0;
+#endif
+	if (!ok) {
+		remove(temp_path);
+	}
+}
 
 FontMetrics font_metrics_get(FT_Face face) {
 	FontMetrics metrics = {0};
@@ -16,9 +223,17 @@ FontMetrics font_metrics_get(FT_Face face) {
 	return metrics;
 }
 
-GlyphMap *glyph_map_create(const char *font, u32 pixel_size) {
+static GlyphMap *glyph_map_rasterize(const char *font, u32 pixel_size) {
+	if (!library_initialized) {
+		FT_Init_FreeType(&library);
+		library_initialized = true;
+	}
+
 	FT_Face face;
-	FT_New_Face(library, font, 0, &face);
+	if (FT_New_Face(library, font, 0, &face)) {
+		printf("Failed to load font %s!\n", font);
+		exit(1);
+	}
 	FT_Set_Pixel_Sizes(face, 0, pixel_size);
 
 	FontMetrics metrics = font_metrics_get(face);
@@ -26,6 +241,7 @@ GlyphMap *glyph_map_create(const char *font, u32 pixel_size) {
 	GlyphMap *map = (GlyphMap *) malloc(sizeof(GlyphMap));
 
 	map->metrics = metrics;
+	map->pixel_size = pixel_size;
 	map->width = metrics.glyph_width * GLYPH_MAP_COUNT_X;
 	map->height = metrics.glyph_height * GLYPH_MAP_COUNT_Y;
 
@@ -40,7 +256,7 @@ GlyphMap *glyph_map_create(const char *font, u32 pixel_size) {
 		FT_GlyphSlot glyph = face->glyph;
 
 		FT_Load_Glyph(face, glyph_index, FT_LOAD_RENDER);
-		FT_Render_Glyph(glyph, FT_RENDER_MODE_NORMAL);
+		FT_Render_Glyph(glyph, GLYPH_RENDER_MODE);
 
 		FT_Bitmap bitmap = glyph->bitmap;
 		s32 left = glyph->bitmap_left;
@@ -56,21 +272,99 @@ GlyphMap *glyph_map_create(const char *font, u32 pixel_size) {
 		s32 start_x = tile_x * metrics.glyph_width + left;
 		s32 start_y = tile_y * metrics.glyph_height + top;
 
-		for (s32 pixel_y = 0; pixel_y < bitmap.rows; ++pixel_y) {
-			for (s32 pixel_x = 0; pixel_x < bitmap.width; ++pixel_x) {
+		for (u32 pixel_y = 0; pixel_y < bitmap.rows; ++pixel_y) {
+			for (u32 pixel_x = 0; pixel_x < bitmap.width; ++pixel_x) {
 				u8 color = bitmap.buffer[pixel_x + pixel_y * bitmap.width];
 
-				s32 x = start_x + pixel_x;
-				s32 y = start_y + pixel_y;
+				s32 x = start_x + (s32) pixel_x;
+				s32 y = start_y + (s32) pixel_y;
 
 				map->data[x + y * map->width] = color;
 			}
 		}
 	}
 
+	FT_Done_Face(face);
+
 	return map;
 }
 
+static GlyphMap *glyph_map_find(u32 pixel_size) {
+	for (GlyphMap *map : glyph_maps) {
+		if (map->pixel_size == pixel_size) {
+			return map;
+		}
+	}
+
+	return 0;
+}
+
+GlyphMap *glyph_map_create(const char *font, u32 pixel_size) {
+	u64 font_hash = font_file_hash(font);
+
+	GlyphMap *map = glyph_cache_load(font_hash, pixel_size);
+	if (!map) {
+		map = glyph_map_rasterize(font, pixel_size);
+		glyph_cache_store(map, font_hash, pixel_size);
+	}
+
+	std::lock_guard<std::mutex> lock(glyph_maps_mutex);
+	glyph_maps.add(map);
+
+	return map;
+}
+
+static void glyph_map_zoom_worker() {
+	std::unique_lock<std::mutex> lock(glyph_maps_mutex);
+
+	while (true) {
+		u32 pixel_size = zoom_pixel_size;
+
+		GlyphMap *map = glyph_map_find(pixel_size);
+		if (!map) {
+			lock.unlock();
+			map = glyph_map_create(zoom_font, pixel_size);
+			lock.lock();
+		}
+
+		// the size may have changed again while rasterizing
+		if (pixel_size == zoom_pixel_size) {
+			zoom_ready.store(map);
+			zoom_building = false;
+			break;
+		}
+	}
+}
+
+void glyph_map_request(const char *font, u32 pixel_size) {
+	std::lock_guard<std::mutex> lock(glyph_maps_mutex);
+
+	zoom_font = font;
+	zoom_pixel_size = pixel_size;
+
+	if (zoom_building) {
+		return;
+	}
+
+	GlyphMap *map = glyph_map_find(pixel_size);
+	if (map) {
+		zoom_ready.store(map);
+		return;
+	}
+
+	zoom_building = true;
+	std::thread(glyph_map_zoom_worker).detach();
+}
+
+GlyphMap *glyph_map_poll() {
+	return zoom_ready.exchange(0);
+}
+
 void glyph_map_init() {
-	FT_Init_FreeType(&library);
-}
\ No newline at end of file
+	// FreeType is only initialized when the glyph cache misses
+#ifdef _WIN32
+	_mkdir(GLYPH_CACHE_DIRECTORY);
+#else
+	mkdir(GLYPH_CACHE_DIRECTORY, 0755);
+#endif
+}
@@ -23,25 +23,29 @@ const char *CONSTANTS[] = {
 	"NULL", "nullptr", "true", "false"
 };
 
-void highlighting_parse(Pane *pane) {
-	pane->highlights.clear();
+// the lexer looks one character past the token it is in, which may be past the end of the text
+static char highlighting_get_char(Buffer *buffer, u32 pos, u32 len) {
+	return pos < len ? buffer_get_char(buffer, pos) : 0;
+}
 
+// tokens are cut at end, nothing past it is drawn
+static void highlighting_parse_range(Pane *pane, u32 pos, u32 end) {
 	Buffer *buffer = pane->buffer;
 
-	u32 pos = pane->start;
-	u32 len = buffer_length(buffer);
-	while (pos < len && pos < pane->end) {
-		char c = buffer_get_char(buffer, pos);
+	u32 len = MIN(buffer_length(buffer), end);
+	while (pos < len) {
+		char c = highlighting_get_char(buffer, pos, len);
 
 		if (isalpha(c)) {
             char id[ID_MAX_LENGTH];
             u32 id_index = 0;
 			u32 start = pos;
 
+			// identifiers longer than any keyword are still skipped whole, as in minified files
 			while ((isalnum(c) || c == '_') && pos < len) {
-				id[id_index++] = c;
+				if (id_index < ID_MAX_LENGTH - 1) id[id_index++] = c;
 				pos++;
-				c = buffer_get_char(buffer, pos);
+				c = highlighting_get_char(buffer, pos, len);
 			}
 			id[id_index] = 0;
 
@@ -75,7 +79,7 @@ void highlighting_parse(Pane *pane) {
 					c == 'b') &&
 					pos < len) {
 				pos++;
-				c = buffer_get_char(buffer, pos);
+				c = highlighting_get_char(buffer, pos, len);
 			}
 
 			pane->highlights.add({start, pos - 1, COLOR_NUMBER});
@@ -83,10 +87,10 @@ void highlighting_parse(Pane *pane) {
 			u32 start = pos;
 
 			pos++;
-			c = buffer_get_char(buffer, pos);
+			c = highlighting_get_char(buffer, pos, len);
 			while (c != '"' && pos < len) {
 				pos++;
-				c = buffer_get_char(buffer, pos);
+				c = highlighting_get_char(buffer, pos, len);
 			}
 
 			pane->highlights.add({start, pos, COLOR_STRING});
@@ -95,10 +99,10 @@ void highlighting_parse(Pane *pane) {
 			u32 start = pos;
 
 			pos++;
-			c = buffer_get_char(buffer, pos);
+			c = highlighting_get_char(buffer, pos, len);
 			while ((isalnum(c) || c == '_') && pos < len) {
 				pos++;
-				c = buffer_get_char(buffer, pos);
+				c = highlighting_get_char(buffer, pos, len);
 			}
 
 			pane->highlights.add({start, pos, COLOR_DIRECTIVE});
@@ -109,11 +113,11 @@ void highlighting_parse(Pane *pane) {
 			pos++;
 
 			if (pos < len) {
-				c = buffer_get_char(buffer, pos);
+				c = highlighting_get_char(buffer, pos, len);
 				if (c == '/') {
 					while (c != '\n' && pos < len) {
 						pos++;
-						c = buffer_get_char(buffer, pos);
+						c = highlighting_get_char(buffer, pos, len);
 					}
 				}
 			}
@@ -126,3 +130,27 @@ void highlighting_parse(Pane *pane) {
 		}
 	}
 }
+
+void highlighting_parse(Pane *pane) {
+	PROFILE_SCOPE(PROFILE_HIGHLIGHT);
+
+	pane->highlights.clear();
+
+	Buffer *buffer = pane->buffer;
+	if (buffer->wrap_width > 0) {
+		highlighting_parse_range(pane, pane->start, pane->end);
+		return;
+	}
+
+	// only the visible part of each line, so long lines cost no more than short ones
+	u32 width = pane->bounds.width;
+	for (u32 i = 0; i + 1 < pane->bounds.height; ++i) {
+		u32 line = pane->line_start + i;
+		buffer_get_line_start(buffer, line);
+		if (line >= buffer->line_starts.length) break;
+
+		u32 cell;
+		u32 from = pane_get_visible_start(pane, line, &cell);
+		highlighting_parse_range(pane, from, buffer_find_cell(buffer, from, cell, pane->column_offset + width, 0));
+	}
+}
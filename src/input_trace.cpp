@@ -0,0 +1,173 @@
+#include "shin.h"
+
+#include <algorithm>
+
+#define INPUT_TRACE_MAGIC 0x52544853 /* "SHTR" */
+#define INPUT_TRACE_VERSION 1
+#define INPUT_TRACE_WORST_EVENTS 5
+
+static FILE *record_file = 0;
+static f64 record_start_time = 0;
+
+bool input_trace_record_begin(const char *path, f64 now) {
+	record_file = fopen(path, "wb");
+	if (!record_file) {
+		return false;
+	}
+
+	u32 magic = INPUT_TRACE_MAGIC;
+	u32 version = INPUT_TRACE_VERSION;
+	fwrite(&magic, sizeof(u32), 1, record_file);
+	fwrite(&version, sizeof(u32), 1, record_file);
+
+	record_start_time = now;
+	return true;
+}
+
+void input_trace_record(InputEvent event, f64 now) {
+	if (!record_file) return;
+
+	f64 time = now - record_start_time;
+	u32 type = event.type;
+
+	fwrite(&time, sizeof(f64), 1, record_file);
+	fwrite(&type, sizeof(u32), 1, record_file);
+	fwrite(&event.key_comb, sizeof(u16), 1, record_file);
+	fwrite(&event.ch, sizeof(char), 1, record_file);
+}
+
+void input_trace_record_end() {
+	if (!record_file) return;
+
+	fclose(record_file);
+	record_file = 0;
+}
+
+bool input_trace_load(InputTrace *trace, const char *path) {
+	FILE *file = fopen(path, "rb");
+	if (!file) {
+		return false;
+	}
+
+	u32 magic = 0;
+	u32 version = 0;
+	fread(&magic, sizeof(u32), 1, file);
+	fread(&version, sizeof(u32), 1, file);
+
+	if (magic != INPUT_TRACE_MAGIC || version != INPUT_TRACE_VERSION) {
+		fclose(file);
+		return false;
+	}
+
+	trace->events.clear();
+
+	while (true) {
+		InputTraceEvent trace_event = {0};
+		u32 type;
+
+		if (fread(&trace_event.time, sizeof(f64), 1, file) != 1) break;
+		if (fread(&type, sizeof(u32), 1, file) != 1) break;
+		if (fread(&trace_event.event.key_comb, sizeof(u16), 1, file) != 1) break;
+		if (fread(&trace_event.event.ch, sizeof(char), 1, file) != 1) break;
+
+		trace_event.event.type = (InputEventType) type;
+		trace->events.add(trace_event);
+	}
+
+	fclose(file);
+
+	trace->next_event = 0;
+	trace->pending_event = 0;
+	return true;
+}
+
+void input_trace_replay_begin(InputTrace *trace, f64 now, bool max_speed) {
+	trace->start_time = now;
+	trace->max_speed = max_speed;
+	trace->next_event = 0;
+	trace->pending_event = 0;
+}
+
+bool input_trace_replay_next(InputTrace *trace, f64 now, InputEvent *event) {
+	if (trace->next_event >= trace->events.length) {
+		return false;
+	}
+
+	InputTraceEvent *trace_event = &trace->events[trace->next_event];
+
+	if (trace->max_speed) {
+		// one event per frame so that every event gets its own latency
+		if (trace->pending_event < trace->next_event) {
+			return false;
+		}
+	} else if (trace->start_time + trace_event->time > now) {
+		return false;
+	}
+
+	trace_event->dispatch_time = now;
+	*event = trace_event->event;
+
+	trace->next_event++;
+	return true;
+}
+
+f64 input_trace_next_event_time(InputTrace *trace) {
+	if (trace->next_event >= trace->events.length) {
+		return 0;
+	}
+
+	return trace->start_time + trace->events[trace->next_event].time;
+}
+
+void input_trace_frame_presented(InputTrace *trace, f64 now) {
+	for (u32 i = trace->pending_event; i < trace->next_event; ++i) {
+		InputTraceEvent *trace_event = &trace->events[i];
+
+		// at original speed the latency includes time spent waiting for a frame
+		f64 from = trace->max_speed ? trace_event->dispatch_time : trace->start_time + trace_event->time;
+		trace_event->latency = now - from;
+	}
+
+	trace->pending_event = trace->next_event;
+}
+
+bool input_trace_replay_done(InputTrace *trace) {
+	return trace->pending_event >= trace->events.length;
+}
+
+void input_trace_report(InputTrace *trace) {
+	u32 count = trace->pending_event;
+	if (count == 0) {
+		puts("input trace: no events replayed");
+		return;
+	}
+
+	Array<f64> latencies(count);
+	Array<u32> order(count);
+	for (u32 i = 0; i < count; ++i) {
+		latencies.add(trace->events[i].latency * 1000.0);
+		order.add(i);
+	}
+
+	std::sort(latencies.begin(), latencies.end());
+
+	auto percentile = [&](f64 p) {
+		return latencies[(s64) (p * (count - 1) + 0.5)];
+	};
+
+	printf("input trace: %u events, %s speed\n", count, trace->max_speed ? "max" : "original");
+	printf("keystroke to frame ms: p50 %.3f, p90 %.3f, p99 %.3f, max %.3f\n",
+		   percentile(0.50), percentile(0.90), percentile(0.99), percentile(1.0));
+
+	std::sort(order.begin(), order.end(), [&](u32 a, u32 b) {
+		return trace->events[a].latency > trace->events[b].latency;
+	});
+
+	puts("slowest events:");
+	for (u32 i = 0; i < MIN(count, INPUT_TRACE_WORST_EVENTS); ++i) {
+		InputTraceEvent *trace_event = &trace->events[order[i]];
+		printf("  #%u at %.3fs key 0x%03x '%c': %.3f ms\n", order[i], trace_event->time,
+			   trace_event->event.key_comb, isprint((u8) trace_event->event.ch) ? trace_event->event.ch : ' ',
+			   trace_event->latency * 1000.0);
+	}
+}
@@ -0,0 +1,476 @@
+#include "shin.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <direct.h>
+#define PATH_MAX 1024
+#else
+#include <dirent.h>
+#include <limits.h>
+#include <sys/stat.h>
+#endif
+
+#define JOURNAL_DIRECTORY "journal"
+#define JOURNAL_MAGIC 0x4E4A4853 /* "SHJN" */
+#define JOURNAL_VERSION 2
+
+// how long an edit may sit in memory before it reaches the journal file
+#define JOURNAL_FLUSH_INTERVAL_MS 100
+
+enum JournalOp : u32 {
+	JOURNAL_INSERT = 0,
+	JOURNAL_DELETE,
+	JOURNAL_REPLACE,
+
+	// value is the length, the text follows packed into as many records as it needs (version 2)
+	JOURNAL_INSERT_TEXT
+};
+
+struct JournalRecord {
+	u32 op;
+	u32 pos;
+	u32 value;
+};
+
+struct JournalHeader {
+	u32 magic;
+	u32 version;
+	u64 base_size;
+	u64 base_mtime;
+	u32 path_length;
+};
+
+struct Journal {
+	char *path;
+	char *file_path;
+	u64 base_size;
+	u64 base_mtime;
+
+	// only touched by the journal thread
+	FILE *file;
+
+	// guarded by journal_mutex
+	Array<JournalRecord> pending;
+	bool discarded;
+
+	// edits made while a save is writing, they start the next journal
+	Array<JournalRecord> since_save;
+
+	// edits of a batch, only touched by the main thread and handed over when the batch ends
+	Array<JournalRecord> batch;
+};
+
+static std::mutex journal_mutex;
+static std::condition_variable journal_wake;
+static Array<Journal *> journals;
+static bool journal_stop = false;
+static std::thread journal_thread;
+
+// while a batch is open edits collect in their journal's batch and reach pending all at once
+static u32 journal_batch_depth = 0;
+static Array<Journal *> journal_batched;
+
+static void journal_get_path(char *path, u32 path_size, const char *file_path) {
+	char absolute_path[PATH_MAX];
+#ifdef _WIN32
+	if (!_fullpath(absolute_path, file_path, sizeof(absolute_path))) {
+#else
+	if (!realpath(file_path, absolute_path)) {
+#endif
+		snprintf(absolute_path, sizeof(absolute_path), "%s", file_path);
+	}
+
+	// FNV-1a
+	u64 hash = 0xcbf29ce484222325ULL;
+	for (char *c = absolute_path; *c; ++c) {
+		hash ^= (u8) *c;
+		hash *= 0x100000001b3ULL;
+	}
+
+	snprintf(path, path_size, "%s/%016llx.jnl", JOURNAL_DIRECTORY, (unsigned long long) hash);
+}
+
+static Journal *journal_create(Buffer *buffer) {
+	char path[PATH_MAX];
+	journal_get_path(path, sizeof(path), buffer->file_path);
+
+	Journal *journal = new Journal;
+	journal->path = strdup(path);
+	journal->file_path = strdup(buffer->file_path);
+	journal->base_size = buffer->disk_size;
+	journal->base_mtime = buffer->disk_mtime;
+	journal->file = 0;
+	journal->discarded = false;
+
+	std::lock_guard<std::mutex> lock(journal_mutex);
+	journals.add(journal);
+
+	return journal;
+}
+
+static bool journal_write_header(Journal *journal) {
+	journal->file = fopen(journal->path, "wb");
+	if (!journal->file) return false;
+
+	JournalHeader header;
+	header.magic = JOURNAL_MAGIC;
+	header.version = JOURNAL_VERSION;
+	header.base_size = journal->base_size;
+	header.base_mtime = journal->base_mtime;
+	header.path_length = strlen(journal->file_path);
+
+	fwrite(&header, sizeof(header), 1, journal->file);
+	fwrite(journal->file_path, 1, header.path_length, journal->file);
+	return true;
+}
+
+static void journal_destroy(Journal *journal) {
+	if (journal->file) {
+		fclose(journal->file);
+		remove(journal->path);
+	}
+
+	free(journal->path);
+	free(journal->file_path);
+	delete journal;
+}
+
+// one pass of the journal thread: every journal's pending edits become a single write
+static void journal_flush() {
+	Array<Journal *> work;
+	Array<Array<JournalRecord> *> work_records;
+
+	{
+		std::lock_guard<std::mutex> lock(journal_mutex);
+
+		for (s64 i = 0; i < journals.length; ++i) {
+			Journal *journal = journals[i];
+
+			Array<JournalRecord> *records = new Array<JournalRecord>;
+			if (!journal->discarded) {
+				for (JournalRecord record : journal->pending) {
+					records->add(record);
+				}
+			}
+			journal->pending.clear();
+
+			work.add(journal);
+			work_records.add(records);
+
+			if (journal->discarded) {
+				journals.ordered_remove(i);
+				i--;
+			}
+		}
+	}
+
+	// in list order, so a discarded journal is removed before its successor recreates the file
+	for (s64 i = 0; i < work.length; ++i) {
+		Journal *journal = work[i];
+		Array<JournalRecord> *records = work_records[i];
+
+		if (journal->discarded) {
+			journal_destroy(journal);
+		} else if (records->length > 0 && (journal->file || journal_write_header(journal))) {
+			fwrite(records->data, sizeof(JournalRecord), records->length, journal->file);
+			fflush(journal->file);
+		}
+
+		delete records;
+	}
+}
+
+static void journal_worker() {
+	std::unique_lock<std::mutex> lock(journal_mutex);
+
+	while (!journal_stop) {
+		journal_wake.wait_for(lock, std::chrono::milliseconds(JOURNAL_FLUSH_INTERVAL_MS));
+
+		lock.unlock();
+		journal_flush();
+		lock.lock();
+	}
+}
+
+// the text is packed straight into the records after its header
+static void journal_add_text(Array<JournalRecord> *records, u32 pos, const char *text, u32 length) {
+	u32 count = 1 + (length + sizeof(JournalRecord) - 1) / sizeof(JournalRecord);
+	if (records->length + count >= records->allocated) {
+		records->reserve(MAX(records->length + count + 1, records->allocated * 2));
+	}
+
+	JournalRecord *record = records->data + records->length;
+	record->op = JOURNAL_INSERT_TEXT;
+	record->pos = pos;
+	record->value = length;
+
+	memset(record + 1, 0, (count - 1) * sizeof(JournalRecord));
+	memcpy(record + 1, text, length);
+	records->length += count;
+}
+
+static Array<JournalRecord> *journal_batch_add(Journal *journal) {
+	if (journal->batch.length == 0) {
+		journal_batched.add(journal);
+	}
+	return &journal->batch;
+}
+
+static bool journal_begin_record(Buffer *buffer) {
+	// nothing is journaled before journal_init, e.g. while recovering or benchmarking
+	if (!buffer->file_path || !journal_thread.joinable()) return false;
+
+	if (!buffer->journal) {
+		buffer->journal = journal_create(buffer);
+	}
+
+	return true;
+}
+
+void journal_record(Buffer *buffer, u32 op, u32 pos, u32 value) {
+	if (!journal_begin_record(buffer)) return;
+
+	JournalRecord record;
+	record.op = op;
+	record.pos = pos;
+	record.value = value;
+
+	if (buffer->save_job) {
+		buffer->journal->since_save.add(record);
+	}
+
+	if (journal_batch_depth > 0) {
+		journal_batch_add(buffer->journal)->add(record);
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(journal_mutex);
+	buffer->journal->pending.add(record);
+}
+
+void journal_insert(Buffer *buffer, u32 pos, char ch) {
+	journal_record(buffer, JOURNAL_INSERT, pos, (u8) ch);
+}
+
+void journal_insert_text(Buffer *buffer, u32 pos, const char *text, u32 length) {
+	if (!journal_begin_record(buffer)) return;
+
+	if (buffer->save_job) {
+		journal_add_text(&buffer->journal->since_save, pos, text, length);
+	}
+
+	if (journal_batch_depth > 0) {
+		journal_add_text(journal_batch_add(buffer->journal), pos, text, length);
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(journal_mutex);
+	journal_add_text(&buffer->journal->pending, pos, text, length);
+}
+
+void journal_delete(Buffer *buffer, u32 pos, u32 count) {
+	journal_record(buffer, JOURNAL_DELETE, pos, count);
+}
+
+void journal_replace(Buffer *buffer, u32 pos, char ch) {
+	journal_record(buffer, JOURNAL_REPLACE, pos, (u8) ch);
+}
+
+void journal_discard(Buffer *buffer) {
+	Journal *journal = buffer->journal;
+	if (!journal) return;
+
+	buffer->journal = 0;
+
+	// the journal thread frees it, so the open batch must forget it first
+	for (s64 i = 0; i < journal_batched.length; ++i) {
+		if (journal_batched[i] == journal) {
+			journal_batched.unordered_remove(i);
+			break;
+		}
+	}
+
+	std::lock_guard<std::mutex> lock(journal_mutex);
+	journal->discarded = true;
+}
+
+void journal_batch_begin() {
+	journal_batch_depth++;
+}
+
+// the whole batch becomes one hand-over and the journal thread writes it right away
+void journal_batch_end() {
+	if (journal_batch_depth == 0 || --journal_batch_depth > 0 || journal_batched.length == 0) return;
+
+	{
+		std::lock_guard<std::mutex> lock(journal_mutex);
+		for (Journal *journal : journal_batched) {
+			for (JournalRecord record : journal->batch) {
+				journal->pending.add(record);
+			}
+			journal->batch.clear();
+		}
+	}
+	journal_batched.clear();
+
+	journal_wake.notify_one();
+}
+
+void journal_saved(Buffer *buffer) {
+	Journal *journal = buffer->journal;
+	if (!journal) return;
+
+	// the file now holds the snapshot, only edits made during the save are still unsaved
+	Array<JournalRecord> since_save;
+	for (JournalRecord record : journal->since_save) {
+		since_save.add(record);
+	}
+
+	journal_discard(buffer);
+
+	if (since_save.length > 0) {
+		buffer->journal = journal_create(buffer);
+
+		std::lock_guard<std::mutex> lock(journal_mutex);
+		for (JournalRecord record : since_save) {
+			buffer->journal->pending.add(record);
+		}
+	}
+}
+
+void journal_save_failed(Buffer *buffer) {
+	if (buffer->journal) {
+		buffer->journal->since_save.clear();
+	}
+}
+
+static void journal_recover_file(const char *journal_path) {
+	FILE *file = fopen(journal_path, "rb");
+	if (!file) return;
+
+	JournalHeader header;
+	char file_path[PATH_MAX];
+	if (fread(&header, sizeof(header), 1, file) != 1 || header.magic != JOURNAL_MAGIC ||
+		header.version > JOURNAL_VERSION || header.path_length >= sizeof(file_path) ||
+		fread(file_path, 1, header.path_length, file) != header.path_length) {
+		fclose(file);
+		remove(journal_path);
+		return;
+	}
+	file_path[header.path_length] = 0;
+
+	Array<JournalRecord> records;
+	JournalRecord record;
+	while (fread(&record, sizeof(record), 1, file) == 1) {
+		records.add(record);
+	}
+	fclose(file);
+
+	Buffer *buffer = buffer_create(32);
+	buffer->file_path = strdup(file_path);
+	read_file_to_buffer(buffer);
+	load_wait_all(false);
+
+	if (buffer->disk_size != header.base_size || buffer->disk_mtime != header.base_mtime) {
+		fprintf(stderr, "%s changed since its journal was written, discarding its unsaved edits\n", file_path);
+	} else {
+		// replaying must not journal the replayed edits again
+		char *path = buffer->file_path;
+		buffer->file_path = 0;
+
+		u32 edits = 0;
+		for (s64 i = 0; i < records.length; ++i, ++edits) {
+			JournalRecord record = records[i];
+
+			if (record.op == JOURNAL_INSERT) {
+				buffer_insert(buffer, record.pos, (char) record.value);
+			} else if (record.op == JOURNAL_DELETE) {
+				buffer_delete_multiple(buffer, record.pos, record.value);
+			} else if (record.op == JOURNAL_REPLACE) {
+				buffer_replace(buffer, record.pos, (char) record.value);
+			} else if (record.op == JOURNAL_INSERT_TEXT) {
+				u32 count = (record.value + sizeof(JournalRecord) - 1) / sizeof(JournalRecord);
+
+				// a crash can cut the text short, the edit is then lost with everything after it
+				if (i + count >= records.length) break;
+
+				buffer_insert_multiple(buffer, record.pos, (const char *) (records.data + i + 1), record.value);
+				i += count;
+			}
+		}
+
+		buffer->file_path = path;
+		if (write_buffer_to_file(buffer)) {
+			fprintf(stderr, "Recovered %u unsaved edits to %s\n", edits, file_path);
+		}
+	}
+
+	free(buffer->file_path);
+	buffer_destroy(buffer);
+	remove(journal_path);
+}
+
+void journal_recover() {
+	char journal_path[PATH_MAX];
+
+#ifdef _WIN32
+	WIN32_FIND_DATAA find_data;
+	HANDLE find = FindFirstFileA(JOURNAL_DIRECTORY "/*.jnl", &find_data);
+	if (find == INVALID_HANDLE_VALUE) return;
+
+	do {
+		snprintf(journal_path, sizeof(journal_path), "%s/%s", JOURNAL_DIRECTORY, find_data.cFileName);
+		journal_recover_file(journal_path);
+	} while (FindNextFileA(find, &find_data));
+
+	FindClose(find);
+#else
+	DIR *directory = opendir(JOURNAL_DIRECTORY);
+	if (!directory) return;
+
+	struct dirent *entry;
+	while ((entry = readdir(directory))) {
+		const char *extension = strrchr(entry->d_name, '.');
+		if (!extension || strcmp(extension, ".jnl") != 0) continue;
+
+		snprintf(journal_path, sizeof(journal_path), "%s/%s", JOURNAL_DIRECTORY, entry->d_name);
+		journal_recover_file(journal_path);
+	}
+
+	closedir(directory);
+#endif
+}
+
+void journal_init() {
+#ifdef _WIN32
+	_mkdir(JOURNAL_DIRECTORY);
+#else
+	mkdir(JOURNAL_DIRECTORY, 0755);
+#endif
+
+	journal_recover();
+	journal_thread = std::thread(journal_worker);
+}
+
+void journal_shutdown() {
+	if (!journal_thread.joinable()) return;
+
+	{
+		std::lock_guard<std::mutex> lock(journal_mutex);
+		journal_stop = true;
+
+		// a clean exit leaves nothing to recover
+		for (Journal *journal : journals) {
+			journal->discarded = true;
+		}
+	}
+
+	journal_wake.notify_one();
+	journal_thread.join();
+	journal_flush();
+}
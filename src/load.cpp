@@ -0,0 +1,263 @@
+#include "shin.h"
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+// the first chunk is read synchronously so the first page is there on the next frame
+#define LOAD_FIRST_CHUNK_SIZE (64 * 1024)
+#define LOAD_CHUNK_SIZE (16 * 1024 * 1024)
+
+// positions are u32 and buffer_grow_if_needed doubles the size, so stay below 2 GB
+#define LOAD_MAX_SIZE 0x7FFF0000u
+
+struct LoadJob {
+	Buffer *buffer;
+	FILE *file;
+	char *data;
+	u32 total;
+
+	// guarded by mutex: bytes readable by the main thread and their new line starts
+	std::mutex mutex;
+	u32 loaded;
+	Array<u32> line_starts;
+
+	std::atomic<bool> cancel;
+	std::atomic<bool> finished;
+	std::thread thread;
+};
+
+static Array<LoadJob *> load_jobs;
+
+static void load_index_lines(Array<u32> *line_starts, const char *data, u32 from, u32 to) {
+	const char *pos = data + from;
+	const char *end = data + to;
+
+	while ((pos = (const char *) memchr(pos, '\n', end - pos))) {
+		pos++;
+		line_starts->add((u32) (pos - data));
+	}
+}
+
+static void load_job_worker(LoadJob *job) {
+	u32 loaded = job->loaded;
+	Array<u32> line_starts;
+
+	while (loaded < job->total && !job->cancel) {
+		u32 chunk = MIN(job->total - loaded, (u32) LOAD_CHUNK_SIZE);
+		u32 size_read = (u32) fread(job->data + loaded, 1, chunk, job->file);
+		if (size_read == 0) break;
+
+		// index the chunk before publishing it so the lines arrive with the text
+		line_starts.clear();
+		load_index_lines(&line_starts, job->data, loaded, loaded + size_read);
+		loaded += size_read;
+
+		std::lock_guard<std::mutex> lock(job->mutex);
+		for (u32 start : line_starts) {
+			job->line_starts.add(start);
+		}
+		job->loaded = loaded;
+	}
+
+	fclose(job->file);
+	job->finished = true;
+}
+
+static void load_job_publish(LoadJob *job) {
+	Buffer *buffer = job->buffer;
+
+	std::lock_guard<std::mutex> lock(job->mutex);
+
+	// the last line grows with the new text
+	buffer_invalidate_lines(buffer, buffer->gap_start);
+
+	// the line index may already have been extended lazily past some of these
+	u32 last_start = buffer->line_starts[buffer->line_starts.length - 1];
+	for (u32 start : job->line_starts) {
+		if (start > last_start) {
+			buffer->line_starts.add(start);
+		}
+	}
+	job->line_starts.clear();
+
+	buffer->gap_start = job->loaded;
+}
+
+// the buffer only matches the file once all of it has arrived
+static void load_end(Buffer *buffer, u32 loaded, u32 total) {
+	buffer->saved_version = buffer->edit_version;
+
+	if (buffer->load_cursor != UINT32_MAX) {
+		buffer_set_cursor(buffer, buffer->load_cursor);
+		buffer->load_cursor = UINT32_MAX;
+	}
+
+	if (loaded == total) return;
+
+	fprintf(stderr, "Only %u of %u bytes of %s could be read\n", loaded, total, buffer->file_path);
+	buffer->load_incomplete = true;
+}
+
+static void load_job_finish(LoadJob *job) {
+	if (job->thread.joinable()) {
+		job->thread.join();
+	}
+
+	load_job_publish(job);
+	job->buffer->load_job = 0;
+
+	// a cancelled load is replaced by another one or the editor is closing
+	Buffer *buffer = job->buffer;
+	bool cancel = job->cancel;
+	if (!cancel) {
+		load_end(buffer, job->loaded, job->total);
+	} else {
+		buffer->load_cursor = UINT32_MAX;
+	}
+
+	for (s64 i = 0; i < load_jobs.length; ++i) {
+		if (load_jobs[i] == job) {
+			load_jobs.ordered_remove(i);
+			break;
+		}
+	}
+
+	delete job;
+
+	// reloading starts a new job, so only once this one is gone
+	if (!cancel) {
+		watch_recheck(buffer);
+	}
+}
+
+static u64 load_open(Buffer *buffer, FILE **file) {
+	*file = fopen(buffer->file_path, "rb");
+	if (!*file) return 0;
+
+	fseek(*file, 0, SEEK_END);
+	u64 file_size = ftell(*file);
+
+	if (file_size > LOAD_MAX_SIZE) {
+		fprintf(stderr, "%s is larger than %u bytes, only the beginning is loaded\n", buffer->file_path, LOAD_MAX_SIZE);
+		file_size = LOAD_MAX_SIZE;
+	}
+
+	return file_size;
+}
+
+// appends [offset, total) of the file at the end of the buffer, the gap must already be there
+static void load_begin(Buffer *buffer, FILE *file, u32 offset, u32 total) {
+	fseek(file, offset, SEEK_SET);
+
+	// the loader writes into data from another thread, it must not be shared with a save
+	if (buffer->save_job) {
+		save_prepare_edit(buffer, 0, buffer->size);
+	}
+
+	u32 first_chunk = MIN(total - offset, (u32) LOAD_FIRST_CHUNK_SIZE);
+	u32 size_read = (u32) fread(buffer->data + offset, 1, first_chunk, file);
+
+	// an appended tail grows the old last line, like load_job_publish
+	buffer_invalidate_lines(buffer, offset);
+	load_index_lines(&buffer->line_starts, buffer->data, offset, offset + size_read);
+	buffer->gap_start = offset + size_read;
+
+	if (offset + size_read == total || size_read < first_chunk) {
+		fclose(file);
+		load_end(buffer, offset + size_read, total);
+		return;
+	}
+
+	// the rest streams in behind the watermark, edits are blocked until it is done
+	LoadJob *job = new LoadJob;
+	job->buffer = buffer;
+	job->file = file;
+	job->data = buffer->data;
+	job->total = total;
+	job->loaded = offset + size_read;
+	job->cancel = false;
+	job->finished = false;
+
+	buffer->load_job = job;
+	load_jobs.add(job);
+
+	job->thread = std::thread(load_job_worker, job);
+}
+
+void read_file_to_buffer(Buffer *buffer) {
+	if (buffer->file_path == 0) return;
+
+	if (buffer->load_job) {
+		buffer->load_job->cancel = true;
+		load_job_finish(buffer->load_job);
+	}
+
+	FILE *file;
+	u64 file_size = load_open(buffer, &file);
+	if (!file) return;
+
+	buffer_clear(buffer);
+	buffer_grow_if_needed(buffer, file_size);
+
+	buffer->load_incomplete = false;
+	buffer->changed_on_disk = false;
+	journal_discard(buffer);
+	watch_update_disk_state(buffer);
+	buffer->disk_size = file_size;
+
+	load_begin(buffer, file, 0, (u32) file_size);
+}
+
+void load_file_tail(Buffer *buffer) {
+	if (buffer->file_path == 0 || buffer->load_job) return;
+
+	FILE *file;
+	u64 file_size = load_open(buffer, &file);
+	if (!file) return;
+
+	u32 length = buffer_length(buffer);
+	if (file_size <= length) {
+		fclose(file);
+		return;
+	}
+
+	// the appended lines go after the last indexed one, so index everything before
+	buffer_get_line_start(buffer, UINT32_MAX);
+
+	buffer_shift_gap_to_position(buffer, length);
+	buffer_grow_if_needed(buffer, (u32) file_size - length);
+
+	watch_update_disk_state(buffer);
+	buffer->disk_size = file_size;
+
+	load_begin(buffer, file, length, (u32) file_size);
+}
+
+bool load_get_progress(Buffer *buffer, u32 *percent) {
+	LoadJob *job = buffer->load_job;
+	if (!job) return false;
+
+	*percent = (u32) ((u64) buffer->gap_start * 100 / job->total);
+	return true;
+}
+
+void load_poll() {
+	for (s64 i = 0; i < load_jobs.length; ++i) {
+		LoadJob *job = load_jobs[i];
+
+		if (job->finished) {
+			load_job_finish(job);
+			i--;
+		} else {
+			load_job_publish(job);
+		}
+	}
+}
+
+void load_wait_all(bool cancel) {
+	while (load_jobs.length > 0) {
+		load_jobs[0]->cancel = cancel;
+		load_job_finish(load_jobs[0]);
+	}
+}
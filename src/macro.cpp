@@ -0,0 +1,56 @@
+#include "shin.h"
+
+// macros can be stored under any printable key, like q{register} in vim
+#define MACRO_REGISTER_COUNT 128
+
+// a macro that replays itself, directly or through others, stops at this depth
+#define MACRO_MAX_DEPTH 32
+
+static Array<InputEvent> macro_registers[MACRO_REGISTER_COUNT];
+static char macro_recording = 0;
+static u32 macro_depth = 0;
+
+void macro_record_begin(char reg) {
+	if ((u8) reg >= MACRO_REGISTER_COUNT) return;
+
+	macro_registers[(u8) reg].clear();
+	macro_recording = reg;
+}
+
+void macro_record_end() {
+	macro_recording = 0;
+}
+
+bool macro_get_recording(char *reg) {
+	*reg = macro_recording;
+	return macro_recording != 0;
+}
+
+void macro_record_event(InputEvent event) {
+	// a replay inside the recording is recorded as the keys that started it
+	if (!macro_recording || macro_depth > 0) return;
+
+	macro_registers[(u8) macro_recording].add(event);
+}
+
+// runs the events straight through the keymaps, nothing is rendered until the whole replay is done
+void macro_replay(Editor *ed, char reg) {
+	if ((u8) reg >= MACRO_REGISTER_COUNT || macro_depth >= MACRO_MAX_DEPTH) return;
+
+	Array<InputEvent> *events = &macro_registers[(u8) reg];
+
+	// replaying the register being recorded would also append to it
+	if (reg == macro_recording || events->length == 0) return;
+
+	// the replayed edits reach the journal as one batch instead of one hand-over per edit
+	macro_depth++;
+	journal_batch_begin();
+
+	for (s64 i = 0; i < events->length && ed->running; ++i) {
+		ed->last_input_event = events->data[i];
+		keymap_dispatch_event(ed);
+	}
+
+	journal_batch_end();
+	macro_depth--;
+}
@@ -0,0 +1,103 @@
+#include "shin.h"
+
+#include <algorithm>
+#include <chrono>
+
+#define PROFILE_MAX_EVENTS (1 << 16)
+
+struct ProfileEvent {
+	u32 zone;
+	f64 start;
+	f64 duration;
+};
+
+const char *PROFILE_ZONE_NAMES[PROFILE_ZONES_COUNT] = {
+	"input", "scroll", "highlight", "render_pane", "upload", "draw", "imgui", "swap"
+};
+
+static f64 zone_frame_times[PROFILE_ZONES_COUNT];
+static f64 zone_history[PROFILE_HISTORY][PROFILE_ZONES_COUNT];
+static u32 history_index = 0;
+static u32 history_count = 0;
+
+// ring of the most recent scopes for chrome trace export
+static ProfileEvent events[PROFILE_MAX_EVENTS];
+static u32 event_index = 0;
+static u32 event_count = 0;
+
+static auto profiler_epoch = std::chrono::steady_clock::now();
+
+f64 profiler_now() {
+	auto elapsed = std::chrono::steady_clock::now() - profiler_epoch;
+	return std::chrono::duration<f64, std::micro>(elapsed).count();
+}
+
+void profiler_add(ProfileZone zone, f64 start, f64 end) {
+	zone_frame_times[zone] += end - start;
+
+	ProfileEvent *event = &events[event_index];
+	event->zone = zone;
+	event->start = start;
+	event->duration = end - start;
+
+	event_index = (event_index + 1) % PROFILE_MAX_EVENTS;
+	event_count = MIN(event_count + 1, PROFILE_MAX_EVENTS);
+}
+
+void profiler_frame_end() {
+	memcpy(zone_history[history_index], zone_frame_times, sizeof(zone_frame_times));
+	memset(zone_frame_times, 0, sizeof(zone_frame_times));
+
+	history_index = (history_index + 1) % PROFILE_HISTORY;
+	history_count = MIN(history_count + 1, PROFILE_HISTORY);
+}
+
+const char *profiler_zone_name(u32 zone) {
+	return PROFILE_ZONE_NAMES[zone];
+}
+
+u32 profiler_history_count() {
+	return history_count;
+}
+
+// age 0 is the most recently finished frame
+f64 profiler_history_get(u32 age, u32 zone) {
+	u32 index = (history_index + PROFILE_HISTORY - 1 - age) % PROFILE_HISTORY;
+	return zone_history[index][zone];
+}
+
+f64 profiler_zone_percentile(u32 zone, f64 p) {
+	if (history_count == 0) return 0;
+
+	f64 samples[PROFILE_HISTORY];
+	for (u32 i = 0; i < history_count; ++i) {
+		samples[i] = profiler_history_get(i, zone);
+	}
+
+	u32 n = (u32) (p * (history_count - 1) + 0.5);
+	std::nth_element(samples, samples + n, samples + history_count);
+	return samples[n];
+}
+
+bool profiler_export_chrome_trace(const char *path) {
+	FILE *file = fopen(path, "w");
+	if (!file) {
+		return false;
+	}
+
+	fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+	u32 first = (event_index + PROFILE_MAX_EVENTS - event_count) % PROFILE_MAX_EVENTS;
+	for (u32 i = 0; i < event_count; ++i) {
+		ProfileEvent *event = &events[(first + i) % PROFILE_MAX_EVENTS];
+
+		fprintf(file, "{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":1}%s\n",
+				PROFILE_ZONE_NAMES[event->zone], event->start, event->duration,
+				i + 1 < event_count ? "," : "");
+	}
+
+	fprintf(file, "]}\n");
+	fclose(file);
+
+	return true;
+}
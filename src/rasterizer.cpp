@@ -0,0 +1,103 @@
+#include "shin.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+static void rasterize_cell(GlyphMap *glyph_map, u32 *screen, s32 width, const u32 *palette, Cell *cell, u32 column, u32 row) {
+	FontMetrics metrics = glyph_map->metrics;
+
+	u32 gw = metrics.glyph_width;
+	u32 gh = metrics.glyph_height;
+
+	u32 cell_x_index = cell->glyph_index % GLYPH_MAP_COUNT_X;
+	u32 cell_y_index = cell->glyph_index / GLYPH_MAP_COUNT_X;
+	u32 cell_x = cell_x_index * gw;
+	u32 cell_y = cell_y_index * gh;
+
+	u32 xoff = column * gw;
+	u32 yoff = row * gh;
+
+	bool invert = cell->glyph_flags & GLYPH_INVERT;
+	u32 fg_hex = palette[cell->foreground];
+	u32 bg_hex = palette[cell->background];
+	if (invert) {
+		fg_hex = color_invert(fg_hex);
+		bg_hex = color_invert(bg_hex);
+	}
+
+	f32 fg[3];
+	color_set_rgb_from_hex(fg, fg_hex);
+	f32 temp = fg[0];
+	fg[0] = fg[2];
+	fg[2] = temp;
+
+	f32 bg[3];
+	color_set_rgb_from_hex(bg, bg_hex);
+
+	for (u32 y = 0; y < gh; ++y) {
+		for (u32 x = 0; x < gw; ++x) {
+			u8 glyph_alpha_int = glyph_map->data[(cell_x + x) + (cell_y + y) * glyph_map->width];
+			f32 glyph_alpha = (f32)(glyph_alpha_int) / 255.0f;
+
+			f32 pixel_rgb[3];
+			/* TODO: somehow optimise those four lines */
+			pixel_rgb[0] = (glyph_alpha * fg[0]) + (1.0 - glyph_alpha) * bg[0];
+			pixel_rgb[1] = (glyph_alpha * fg[1]) + (1.0 - glyph_alpha) * bg[1];
+			pixel_rgb[2] = (glyph_alpha * fg[2]) + (1.0 - glyph_alpha) * bg[2];
+
+			u32 pixel = color_hex_from_rgb(pixel_rgb);
+
+			screen[(xoff + x) + (yoff + y) * width] = pixel;
+		}
+	}
+}
+
+// rasterizes the draw buffer into screen, shared by the software renderer and headless builds
+void software_rasterize(DrawBuffer *buffer, GlyphMap *glyph_map, u32 *screen, s32 width, s32 height, const u32 *palette) {
+	std::vector<std::thread> threads;
+	std::atomic<u32> row_index;
+	row_index = 0;
+
+	auto loop = [&]() {
+		while (row_index < buffer->rows) {
+			u32 row = row_index++;
+
+			if (row >= buffer->rows) break;
+
+			for (u32 column = 0; column < buffer->columns; ++column) {
+				Cell *cell = &buffer->cells[column + row * buffer->columns];
+
+				if (cell->glyph_flags != 0 || cell->glyph_index != 0) {
+					rasterize_cell(glyph_map, screen, width, palette, cell, column, row);
+				} else {
+					// empty cells are only their background, which a selection can color too
+					u32 bg_color = palette[cell->background];
+
+					FontMetrics metrics = glyph_map->metrics;
+					u32 gw = metrics.glyph_width;
+					u32 gh = metrics.glyph_height;
+
+					u32 xs = gw * column;
+					u32 ys = gh * row;
+					for (u32 y = ys; y < ys + gh; ++y) {
+						for (u32 x = xs; x < xs + gw; ++x) {
+							screen[x + y * width] = bg_color;
+						}
+					}
+				}
+			}
+		}
+	};
+
+	u32 cores = 8;
+	for (u32 i = 0; i < cores; ++i) {
+		std::thread t(loop);
+
+		threads.push_back(move(t));
+	}
+
+	for (auto &t : threads) {
+		t.join();
+	}
+}
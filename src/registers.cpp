@@ -0,0 +1,223 @@
+#include "shin.h"
+
+#define REGISTER_COUNT 128
+#define REGISTER_UNNAMED '"'
+#define REGISTER_YANK '0'
+#define REGISTER_CLIPBOARD '+'
+
+// register contents are never modified, registers holding the same text share one copy
+struct RegisterText {
+	// zero terminated so it can be handed to the clipboard as is
+	char *data;
+	u32 length;
+	u32 references;
+	bool linewise;
+
+	// yanked from a block selection, one line per row and put back as a block
+	bool blockwise;
+};
+
+static RegisterText *registers[REGISTER_COUNT];
+
+static ClipboardGetCallback clipboard_get = 0;
+static ClipboardSetCallback clipboard_set = 0;
+
+// the clipboard register changed and the system clipboard has not been told yet
+static bool clipboard_pending = false;
+
+static RegisterText *register_text_create(u32 length, bool linewise) {
+	RegisterText *text = (RegisterText *) malloc(sizeof(RegisterText));
+	text->data = (char *) malloc(length + 1);
+	text->data[length] = 0;
+	text->length = length;
+	text->references = 0;
+	text->linewise = linewise;
+	text->blockwise = false;
+	return text;
+}
+
+static void register_text_release(RegisterText *text) {
+	if (text && --text->references == 0) {
+		free(text->data);
+		free(text);
+	}
+}
+
+static u32 register_index(char reg) {
+	if (reg == 0) return REGISTER_UNNAMED;
+	if (reg == '*') return REGISTER_CLIPBOARD;
+
+	// named registers are not case sensitive
+	return (u32) tolower((u8) reg) % REGISTER_COUNT;
+}
+
+static void register_set(u32 index, RegisterText *text) {
+	if (registers[index] == text) return;
+
+	text->references++;
+	register_text_release(registers[index]);
+	registers[index] = text;
+
+	if (index == REGISTER_CLIPBOARD) {
+		clipboard_pending = true;
+	}
+}
+
+// deletes only fill the unnamed register and the one asked for, the yank register keeps the last yank
+static void register_store(RegisterText *text, char reg, bool deleted) {
+	register_set(REGISTER_UNNAMED, text);
+	if (!deleted) {
+		register_set(REGISTER_YANK, text);
+	}
+	if (reg) {
+		register_set(register_index(reg), text);
+	}
+}
+
+void register_yank(Buffer *buffer, char reg, u32 from, u32 to, bool linewise, bool deleted) {
+	u32 length = to - from;
+
+	// linewise text always ends in a line break, even when taken from the last line
+	bool add_newline = linewise && (length == 0 || buffer_get_char(buffer, to - 1) != '\n');
+
+	RegisterText *text = register_text_create(length + add_newline, linewise);
+	buffer_get_text(buffer, from, to, text->data);
+	if (add_newline) {
+		text->data[length] = '\n';
+	}
+
+	register_store(text, reg, deleted);
+}
+
+// a block yank keeps one line per range
+void register_yank_ranges(Buffer *buffer, char reg, const u32 *ranges, u32 count, bool deleted) {
+	if (count == 0) return;
+
+	u32 length = count - 1;
+	for (u32 i = 0; i < count; ++i) {
+		length += ranges[2 * i + 1] - ranges[2 * i];
+	}
+
+	RegisterText *text = register_text_create(length, false);
+	text->blockwise = true;
+
+	char *data = text->data;
+	for (u32 i = 0; i < count; ++i) {
+		if (i > 0) {
+			*data++ = '\n';
+		}
+		buffer_get_text(buffer, ranges[2 * i], ranges[2 * i + 1], data);
+		data += ranges[2 * i + 1] - ranges[2 * i];
+	}
+
+	register_store(text, reg, deleted);
+}
+
+// the clipboard is only read when it is pasted from
+static RegisterText *register_get(Editor *ed, char reg) {
+	u32 index = register_index(reg);
+
+	if (index == REGISTER_CLIPBOARD && clipboard_get && !clipboard_pending) {
+		const char *clipboard = clipboard_get(ed);
+		if (clipboard) {
+			u32 length = strlen(clipboard);
+
+			RegisterText *text = register_text_create(length, length > 0 && clipboard[length - 1] == '\n');
+			memcpy(text->data, clipboard, length);
+			register_set(index, text);
+
+			// it came from the clipboard, there is nothing to send back
+			clipboard_pending = false;
+		}
+	}
+
+	return registers[index];
+}
+
+// each row goes into its own line at the cursor column, with lines added at the end when the block runs past it
+static void register_put_block(Buffer *buffer, RegisterText *text, bool before) {
+	u32 line = buffer_get_line_index(buffer, buffer->cursor);
+	u32 pos = buffer->cursor;
+	if (!before && pos < cursor_get_end_of_line(buffer, pos)) {
+		pos = cursor_next(buffer, pos);
+	}
+	u32 column = buffer_get_cell_column(buffer, pos);
+
+	Array<u32> row_starts;
+	row_starts.add(0);
+	for (u32 i = 0; i < text->length; ++i) {
+		if (text->data[i] == '\n') row_starts.add(i + 1);
+	}
+	u32 rows = (u32) row_starts.length;
+	row_starts.add(text->length + 1);
+
+	u32 last_line = buffer_get_line_index(buffer, buffer_length(buffer));
+	for (; last_line < line + rows - 1; ++last_line) {
+		buffer_insert(buffer, buffer_length(buffer), '\n');
+	}
+
+	// back to front, the lines above the one being edited keep their indexed starts
+	for (s64 i = rows - 1; i >= 0; --i) {
+		pos = buffer_get_cell_position(buffer, line + (u32) i, column);
+		buffer_insert_multiple(buffer, pos, text->data + row_starts[i], row_starts[i + 1] - row_starts[i] - 1);
+	}
+
+	buffer_set_cursor(buffer, pos);
+}
+
+void register_put(Editor *ed, Buffer *buffer, char reg, bool before) {
+	RegisterText *text = register_get(ed, reg);
+	if (!text || text->length == 0) return;
+
+	u32 length = buffer_length(buffer);
+	if ((u64) length + text->length > 0x7FFF0000u) {
+		fprintf(stderr, "Paste would make the buffer larger than 2 GB\n");
+		return;
+	}
+
+	if (text->blockwise) {
+		register_put_block(buffer, text, before);
+		return;
+	}
+
+	u32 pos;
+	if (text->linewise) {
+		if (before) {
+			pos = cursor_get_beginning_of_line(buffer, buffer->cursor);
+		} else {
+			pos = cursor_get_beginning_of_next_line(buffer, buffer->cursor);
+
+			// the last line has no line break for the pasted lines to follow
+			if (pos == length && length > 0 && buffer_get_char(buffer, length - 1) != '\n') {
+				buffer_insert(buffer, length, '\n');
+				pos++;
+			}
+		}
+	} else {
+		pos = before ? buffer->cursor : MIN(cursor_next(buffer, buffer->cursor), length);
+	}
+
+	buffer_insert_multiple(buffer, pos, text->data, text->length);
+
+	// linewise pastes leave the cursor on the first pasted line, others on the last pasted character
+	if (text->linewise) {
+		buffer_set_cursor(buffer, pos);
+	} else {
+		buffer_set_cursor(buffer, cursor_back(buffer, pos + text->length));
+	}
+}
+
+void registers_set_clipboard(ClipboardGetCallback get, ClipboardSetCallback set) {
+	clipboard_get = get;
+	clipboard_set = set;
+}
+
+// called once a frame, so yanking to the clipboard many times in a macro sets it once
+void registers_sync_clipboard(Editor *ed) {
+	if (!clipboard_pending) return;
+	clipboard_pending = false;
+
+	if (clipboard_set && registers[REGISTER_CLIPBOARD]) {
+		clipboard_set(ed, registers[REGISTER_CLIPBOARD]->data);
+	}
+}
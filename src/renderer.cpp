@@ -12,10 +12,6 @@
 
 #include <glfw/glfw3.h>
 
-#include <atomic>
-#include <thread>
-#include <vector>
-
 const f32 quad_vertices[8] = {
 	-1.0f, -1.0f,
 	1.0f, -1.0f,
@@ -89,6 +85,7 @@ static void shaders_init(HardwareRenderer *renderer) {
 	renderer->shader_win_size_slot = glGetUniformLocation(renderer->program, "win_size");
 	renderer->shader_time_slot = glGetUniformLocation(renderer->program, "time");
 	renderer->shader_background_color_slot = glGetUniformLocation(renderer->program, "background_color");
+	renderer->shader_palette_slot = glGetUniformLocation(renderer->program, "palette");
 }
 
 static u32 create_texture(GLint uniform_slot, GLint texture_slot) {
@@ -140,6 +137,10 @@ static void glyph_map_update_texture(GlyphMap *glyph_map) {
 static void renderer_init_glyph_map(HardwareRenderer *renderer) {
 	renderer->glyph_texture = create_texture(renderer->shader_glyph_map_slot, 0);
 	renderer->glyph_texture = create_texture(renderer->shader_cells_slot, 1);
+
+	// cells are read as integers, which cannot be filtered
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 	// renderer->shader_cells_ssbo = create_cells_ssbo();
 
 	glyph_map_update_texture(renderer->glyph_map);
@@ -197,16 +198,30 @@ void HardwareRenderer::query_cell_data() {
 #endif
 	glActiveTexture(GL_TEXTURE1);
 
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, buffer->columns, buffer->rows, 0, GL_RGBA, GL_UNSIGNED_BYTE, buffer->cells);
+	// one texel of two 32 bit integers per cell
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RG32UI, buffer->columns, buffer->rows, 0, GL_RG_INTEGER, GL_UNSIGNED_INT, buffer->cells);
 }
 
 void HardwareRenderer::query_settings(Settings *settings) {
 	glUniform1ui(shader_background_color_slot, color_hex_from_rgb(settings->bg_temp));
+
+	// the shader's palette has room for more colors than there are, the rest read as black
+	u32 palette[PALETTE_SIZE] = {};
+	memcpy(palette, settings->colors, sizeof(settings->colors));
+	glUniform1uiv(shader_palette_slot, PALETTE_SIZE, palette);
 	
 	glfwSwapInterval(settings->vsync ? 1 : 0);
 	glfwSetWindowOpacity(window, settings->opacity);
 }
 
+void HardwareRenderer::query_glyph_map() {
+	glyph_map_update_texture(glyph_map);
+
+	s32 width, height;
+	glfwGetFramebufferSize(window, &width, &height);
+	resize(width, height);
+}
+
 void HardwareRenderer::update_time(f64 time) {
     glUniform1f(shader_time_slot, time);
 }
@@ -290,50 +305,9 @@ void SoftwareRenderer::resize(s32 width, s32 height) {
 }
 
 void SoftwareRenderer::end() {
-    glClear(GL_COLOR_BUFFER_BIT);
-
-    std::vector<std::thread> threads;
-	std::atomic<s32> row_index;
-	row_index = 0;
-
-    auto loop = [&]() {
-        while (row_index < buffer->rows) {
-			u32 row = row_index++;
-
-			if (row >= buffer->rows) break;
-
-			for (u32 column = 0; column < buffer->columns; ++column) {
-				Cell *cell = &buffer->cells[column + row * buffer->columns];
-
-				if (cell->glyph_flags != 0 || cell->glyph_index != 0) {
-					render_cell(cell, column, row);
-				} else {
-					FontMetrics metrics = glyph_map->metrics;
-					u32 gw = metrics.glyph_width;
-					u32 gh = metrics.glyph_height;
-
-					u32 xs = gw * column;
-					u32 ys = gh * row;
-					for (u32 y = ys; y < ys + gh; ++y) {
-						for (u32 x = xs; x < xs + gw; ++x) {
-							screen[x + y * width] = bg_color;
-						}
-					}
-				}
-			}
-        }
-    };
-
-	u32 cores = 8;
-    for (u32 i = 0; i < cores; ++i) {
-        std::thread t(loop);
-
-        threads.push_back(move(t));
-    }
+	glClear(GL_COLOR_BUFFER_BIT);
 
-    for (auto &t : threads) {
-        t.join();
-    }
+	software_rasterize(buffer, glyph_map, (u32 *) screen, width, height, palette);
 
 	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, (void *) screen);
 
@@ -346,57 +320,12 @@ void SoftwareRenderer::query_cell_data() {
 void SoftwareRenderer::query_settings(Settings *settings) {
 	glfwSwapInterval(settings->vsync ? 1 : 0);
 	glfwSetWindowOpacity(window, settings->opacity);
-	bg_color = settings->colors[COLOR_BG];
+	memset(palette, 0, sizeof(palette));
+	memcpy(palette, settings->colors, sizeof(settings->colors));
 }
 
-void SoftwareRenderer::update_time(f64 time) {
+void SoftwareRenderer::query_glyph_map() {
 }
 
-void SoftwareRenderer::render_cell(Cell *cell, u32 column, u32 row) {
-	FontMetrics metrics = glyph_map->metrics;
-
-	u32 gw = metrics.glyph_width;
-	u32 gh = metrics.glyph_height;
-
-	u32 cell_x_index = cell->glyph_index % GLYPH_MAP_COUNT_X;
-	u32 cell_y_index = cell->glyph_index / GLYPH_MAP_COUNT_X;
-	u32 cell_x = cell_x_index * gw;
-	u32 cell_y = cell_y_index * gh;
-
-	u32 xoff = column * gw;
-	u32 yoff = row * gh;
-
-	bool invert = cell->glyph_flags & GLYPH_INVERT;
-	u32 fg_hex = cell->foreground;
-	u32 bg_hex = cell->background;
-	if (invert) {
-		fg_hex = color_invert(fg_hex);
-		bg_hex = color_invert(bg_hex);
-	}
-
-	f32 fg[3];
-	color_set_rgb_from_hex(fg, fg_hex);
-	f32 temp = fg[0];
-	fg[0] = fg[2];
-	fg[2] = temp;
-
-	f32 bg[3];
-	color_set_rgb_from_hex(bg, bg_hex);
-
-	for (u32 y = 0; y < gh; ++y) {
-		for (u32 x = 0; x < gw; ++x) {
-			u8 glyph_alpha_int = glyph_map->data[(cell_x + x) + (cell_y + y) * glyph_map->width];
-			f32 glyph_alpha = (f32)(glyph_alpha_int) / 255.0f;
-
-			f32 pixel_rgb[3];
-			/* TODO: somehow optimise those four lines */
-			pixel_rgb[0] = (glyph_alpha * fg[0]) + (1.0 - glyph_alpha) * bg[0];
-			pixel_rgb[1] = (glyph_alpha * fg[1]) + (1.0 - glyph_alpha) * bg[1];
-			pixel_rgb[2] = (glyph_alpha * fg[2]) + (1.0 - glyph_alpha) * bg[2];
-
-			u32 pixel = color_hex_from_rgb(pixel_rgb);
-
-			screen[(xoff + x) + (yoff + y) * width] = pixel;
-		}
-	}
+void SoftwareRenderer::update_time(f64 time) {
 }
@@ -0,0 +1,312 @@
+#include "shin.h"
+
+#include <errno.h>
+
+#include <atomic>
+#include <thread>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <io.h>
+#define PATH_MAX 1024
+#else
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+// caps a single write so progress moves on huge files, still few syscalls
+#define SAVE_CHUNK_SIZE (64 * 1024 * 1024)
+
+struct SaveJob {
+	Buffer *buffer;
+	char *path;
+
+	// frozen view of the gap buffer, data is shared with the buffer until it is edited
+	char *data;
+	u32 size;
+	u32 gap_start;
+	u32 gap_end;
+	u32 edit_version;
+
+	std::atomic<u64> written;
+	std::atomic<bool> finished;
+	bool ok;
+	bool save_again;
+
+	std::thread thread;
+};
+
+static Array<SaveJob *> save_jobs;
+
+static u64 save_job_total(SaveJob *job) {
+	return job->size - (job->gap_end - job->gap_start);
+}
+
+#ifdef _WIN32
+static bool save_job_write(SaveJob *job) {
+	char temp_path[PATH_MAX];
+	snprintf(temp_path, sizeof(temp_path), "%s.shin-tmp", job->path);
+
+	FILE *file = fopen(temp_path, "wb");
+	if (!file) return false;
+
+	const char *segments[2] = { job->data, job->data + job->gap_end };
+	u64 sizes[2] = { job->gap_start, job->size - job->gap_end };
+
+	bool ok = true;
+	for (u32 i = 0; i < 2 && ok; ++i) {
+		for (u64 offset = 0; offset < sizes[i] && ok; offset += SAVE_CHUNK_SIZE) {
+			u64 chunk = MIN(sizes[i] - offset, (u64) SAVE_CHUNK_SIZE);
+			ok = fwrite(segments[i] + offset, 1, chunk, file) == chunk;
+			job->written += chunk;
+		}
+	}
+	ok = ok && fflush(file) == 0 && _commit(_fileno(file)) == 0;
+	fclose(file);
+
+	if (!ok || !MoveFileExA(temp_path, job->path, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+		remove(temp_path);
+		return false;
+	}
+
+	return true;
+}
+#else
+static bool write_all_segments(s32 fd, struct iovec *segments, s32 segment_count, std::atomic<u64> *written) {
+	while (segment_count > 0) {
+		// clamp the request to SAVE_CHUNK_SIZE without copying any data
+		struct iovec request[2];
+		s32 request_count = 0;
+		u64 request_size = 0;
+		for (s32 i = 0; i < segment_count && request_size < SAVE_CHUNK_SIZE; ++i) {
+			request[i] = segments[i];
+			request[i].iov_len = MIN(request[i].iov_len, (size_t) (SAVE_CHUNK_SIZE - request_size));
+			request_size += request[i].iov_len;
+			request_count++;
+		}
+
+		ssize_t result = writev(fd, request, request_count);
+		if (result < 0) {
+			if (errno == EINTR) continue;
+			return false;
+		}
+		*written += result;
+
+		// skip fully written segments and advance into a partially written one
+		while (segment_count > 0 && (size_t) result >= segments->iov_len) {
+			result -= segments->iov_len;
+			segments++;
+			segment_count--;
+		}
+		if (segment_count > 0) {
+			segments->iov_base = (char *) segments->iov_base + result;
+			segments->iov_len -= result;
+		}
+	}
+
+	return true;
+}
+
+static bool save_job_write(SaveJob *job) {
+	// write through symlinks instead of replacing them with a regular file
+	const char *path = job->path;
+	char resolved_path[PATH_MAX];
+	if (realpath(path, resolved_path)) {
+		path = resolved_path;
+	}
+
+	char temp_path[PATH_MAX + 16];
+	snprintf(temp_path, sizeof(temp_path), "%s.XXXXXX", path);
+
+	s32 fd = mkstemp(temp_path);
+	if (fd < 0) return false;
+
+	struct stat st;
+	if (stat(path, &st) == 0) {
+		fchmod(fd, st.st_mode & 07777);
+		if (fchown(fd, st.st_uid, st.st_gid) != 0) {
+			// not owning the original is fine, the file just changes owner
+		}
+	} else {
+		mode_t mask = umask(0);
+		umask(mask);
+		fchmod(fd, 0666 & ~mask);
+	}
+
+	struct iovec segments[2];
+	segments[0].iov_base = job->data;
+	segments[0].iov_len = job->gap_start;
+	segments[1].iov_base = job->data + job->gap_end;
+	segments[1].iov_len = job->size - job->gap_end;
+
+	bool ok = write_all_segments(fd, segments, 2, &job->written) && fsync(fd) == 0;
+	ok = close(fd) == 0 && ok;
+
+	if (!ok || rename(temp_path, path) != 0) {
+		unlink(temp_path);
+		return false;
+	}
+
+	// make the rename itself durable
+	char directory[PATH_MAX];
+	snprintf(directory, sizeof(directory), "%s", path);
+	char *slash = strrchr(directory, '/');
+	if (slash) {
+		*(slash == directory ? slash + 1 : slash) = 0;
+	} else {
+		strcpy(directory, ".");
+	}
+
+	s32 directory_fd = open(directory, O_RDONLY);
+	if (directory_fd >= 0) {
+		fsync(directory_fd);
+		close(directory_fd);
+	}
+
+	return true;
+}
+#endif
+
+static void save_job_snapshot(SaveJob *job, Buffer *buffer) {
+	job->buffer = buffer;
+	job->path = strdup(buffer->file_path);
+	job->data = buffer->data;
+	job->size = buffer->size;
+	job->gap_start = buffer->gap_start;
+	job->gap_end = buffer->gap_end;
+	job->edit_version = buffer->edit_version;
+	job->written = 0;
+	job->finished = false;
+	job->ok = false;
+	job->save_again = false;
+}
+
+static void save_job_worker(SaveJob *job) {
+	job->ok = save_job_write(job);
+	job->finished = true;
+}
+
+bool write_buffer_to_file(Buffer *buffer) {
+	if (buffer->file_path == 0) return false;
+
+	if (buffer->load_incomplete) {
+		fprintf(stderr, "Cannot write %s, it was only partly read\n", buffer->file_path);
+		return false;
+	}
+
+	// never truncate the original: write a temp file next to it and rename it over
+	SaveJob job;
+	save_job_snapshot(&job, buffer);
+	bool ok = save_job_write(&job);
+	if (ok) {
+		buffer->saved_version = job.edit_version;
+		buffer->changed_on_disk = false;
+		watch_update_disk_state(buffer);
+		journal_saved(buffer);
+	} else {
+		fprintf(stderr, "Failed to write %s: %s\n", job.path, strerror(errno));
+	}
+
+	free(job.path);
+	return ok;
+}
+
+void buffer_save_async(Buffer *buffer) {
+	if (buffer->file_path == 0) return;
+
+	// a partially loaded buffer would truncate the file
+	if (buffer->load_job) {
+		fprintf(stderr, "Cannot write %s while it is still loading\n", buffer->file_path);
+		return;
+	}
+	if (buffer->load_incomplete) {
+		fprintf(stderr, "Cannot write %s, it was only partly read\n", buffer->file_path);
+		return;
+	}
+
+	// a save is already in flight, write the newer state once it is done
+	if (buffer->save_job) {
+		buffer->save_job->save_again = true;
+		return;
+	}
+
+	SaveJob *job = new SaveJob;
+	save_job_snapshot(job, buffer);
+	buffer->save_job = job;
+	save_jobs.add(job);
+
+	job->thread = std::thread(save_job_worker, job);
+}
+
+void save_prepare_edit(Buffer *buffer, u32 from, u32 to) {
+	SaveJob *job = buffer->save_job;
+	if (!job || job->data != buffer->data) return;
+
+	// the writer never reads the snapshot's gap, so typing into it needs no copy
+	if (from >= job->gap_start && to <= job->gap_end) return;
+
+	char *data = (char *) malloc(buffer->size);
+	memcpy(data, buffer->data, buffer->size);
+	buffer->data = data;
+}
+
+bool save_get_progress(Buffer *buffer, u32 *percent) {
+	SaveJob *job = buffer->save_job;
+	if (!job) return false;
+
+	u64 total = save_job_total(job);
+	*percent = total ? (u32) (job->written * 100 / total) : 100;
+	return true;
+}
+
+void save_poll() {
+	for (s64 i = 0; i < save_jobs.length; ++i) {
+		SaveJob *job = save_jobs[i];
+		if (!job->finished) continue;
+
+		if (job->thread.joinable()) {
+			job->thread.join();
+		}
+
+		Buffer *buffer = job->buffer;
+		if (job->ok) {
+			buffer->saved_version = job->edit_version;
+			buffer->changed_on_disk = false;
+			watch_update_disk_state(buffer);
+			journal_saved(buffer);
+		} else {
+			fprintf(stderr, "Failed to write %s\n", job->path);
+			journal_save_failed(buffer);
+		}
+
+		if (job->data != buffer->data) {
+			free(job->data);
+		}
+		buffer->save_job = 0;
+
+		if (job->save_again) {
+			buffer_save_async(buffer);
+		}
+
+		save_jobs.ordered_remove(i);
+		i--;
+
+		free(job->path);
+		delete job;
+
+		watch_recheck(buffer);
+	}
+}
+
+void save_wait_all() {
+	while (save_jobs.length > 0) {
+		for (SaveJob *job : save_jobs) {
+			job->thread.join();
+		}
+		save_poll();
+	}
+}
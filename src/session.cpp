@@ -0,0 +1,193 @@
+#include "shin.h"
+
+#define SESSION_FILE "session"
+#define SESSION_MAGIC 0x53534853 /* "SHSS" */
+#define SESSION_VERSION 1
+
+// longer paths mean the file is damaged
+#define SESSION_MAX_PATH 4096
+
+struct SessionHeader {
+	u32 magic;
+	u32 version;
+
+	// the grid the pane bounds were laid out on, used to scale them to the new window
+	u32 columns;
+	u32 rows;
+
+	u32 pane_count;
+	u32 active_pane_index;
+};
+
+struct SessionPane {
+	Bounds bounds;
+	u32 start;
+	u32 end;
+	u32 line_start;
+	u32 cursor;
+	u32 path_length;
+};
+
+// scroll and cursor wait until the pane's buffer has been loaded
+struct SessionRestore {
+	Pane *pane;
+	SessionPane saved;
+};
+
+static Array<SessionRestore> session_restores;
+
+void session_save(Editor *ed, DrawBuffer *draw_buffer) {
+	FILE *f = fopen(SESSION_FILE, "wb");
+	if (!f) {
+		return;
+	}
+
+	SessionHeader header;
+	header.magic = SESSION_MAGIC;
+	header.version = SESSION_VERSION;
+	header.columns = draw_buffer->columns;
+	header.rows = draw_buffer->rows - 1;
+	header.pane_count = ed->pane_count;
+	header.active_pane_index = ed->active_pane_index;
+	fwrite(&header, sizeof(header), 1, f);
+
+	for (u32 i = 0; i < ed->pane_count; ++i) {
+		Pane *pane = &ed->pane_pool[i];
+		Buffer *buffer = pane->buffer;
+
+		SessionPane saved;
+		saved.bounds = pane->bounds;
+		saved.start = pane->start;
+		saved.end = pane->end;
+		saved.line_start = pane->line_start;
+		saved.cursor = buffer->cursor;
+		saved.path_length = buffer->file_path ? strlen(buffer->file_path) : 0;
+
+		// a pane that was never shown still has its restored position pending
+		for (SessionRestore &restore : session_restores) {
+			if (restore.pane == pane) {
+				saved = restore.saved;
+				saved.bounds = pane->bounds;
+			}
+		}
+
+		fwrite(&saved, sizeof(saved), 1, f);
+		fwrite(buffer->file_path, 1, saved.path_length, f);
+	}
+
+	fclose(f);
+}
+
+bool session_restore(Editor *ed, DrawBuffer *draw_buffer) {
+	FILE *f = fopen(SESSION_FILE, "rb");
+	if (!f) {
+		return false;
+	}
+
+	SessionHeader header;
+	if (fread(&header, sizeof(header), 1, f) != 1 || header.magic != SESSION_MAGIC ||
+		header.version != SESSION_VERSION || header.pane_count == 0 || header.pane_count > MAX_PANES) {
+		fclose(f);
+		return false;
+	}
+
+	// read everything first, a truncated session is dropped as a whole
+	SessionPane saved[MAX_PANES];
+	char *paths[MAX_PANES] = {};
+	bool ok = true;
+
+	for (u32 i = 0; i < header.pane_count && ok; ++i) {
+		ok = fread(&saved[i], sizeof(saved[i]), 1, f) == 1 && saved[i].path_length <= SESSION_MAX_PATH;
+		if (!ok || saved[i].path_length == 0) continue;
+
+		paths[i] = (char *) malloc(saved[i].path_length + 1);
+		ok = fread(paths[i], 1, saved[i].path_length, f) == saved[i].path_length;
+		paths[i][saved[i].path_length] = 0;
+	}
+
+	fclose(f);
+
+	if (!ok) {
+		for (u32 i = 0; i < header.pane_count; ++i) {
+			free(paths[i]);
+		}
+		return false;
+	}
+
+	for (u32 i = 0; i < ed->pane_count; ++i) {
+		buffer_destroy(ed->pane_pool[i].buffer);
+	}
+	ed->pane_count = 0;
+
+	u32 columns = draw_buffer->columns;
+	u32 rows = draw_buffer->rows - 1;
+
+	for (u32 i = 0; i < header.pane_count; ++i) {
+		Bounds bounds = bounds_scale(saved[i].bounds, header.columns, header.rows, columns, rows);
+
+		Pane *pane = pane_create(ed, bounds);
+		Buffer *buffer = pane->buffer;
+
+		if (paths[i]) {
+			buffer->file_path = paths[i];
+
+			// session_poll reads the files one at a time, the focused one first
+			buffer->load_deferred = true;
+
+			SessionRestore restore;
+			restore.pane = pane;
+			restore.saved = saved[i];
+			session_restores.add(restore);
+		}
+	}
+
+	if (ed->pane_count == 0) {
+		pane_create(ed, {0, 0, columns, rows});
+	}
+
+	ed->active_pane_index = MIN(header.active_pane_index, ed->pane_count - 1);
+	ed->current_buffer = ed->pane_pool[ed->active_pane_index].buffer;
+
+	return true;
+}
+
+// the focused pane's file is read right away, the others one by one while no load is running
+static void session_load_next(Editor *ed) {
+	Buffer *next = ed->current_buffer->load_deferred ? ed->current_buffer : 0;
+
+	for (u32 i = 0; i < ed->pane_count && !next; ++i) {
+		if (ed->pane_pool[i].buffer->load_job) return;
+	}
+
+	for (u32 i = 0; i < ed->pane_count && !next; ++i) {
+		if (ed->pane_pool[i].buffer->load_deferred) next = ed->pane_pool[i].buffer;
+	}
+
+	if (next) {
+		next->load_deferred = false;
+		read_file_to_buffer(next);
+	}
+}
+
+void session_poll(Editor *ed) {
+	session_load_next(ed);
+
+	for (s64 i = 0; i < session_restores.length; ++i) {
+		SessionRestore *restore = &session_restores[i];
+		Pane *pane = restore->pane;
+		Buffer *buffer = pane->buffer;
+
+		if (buffer->load_deferred || buffer->load_job) continue;
+
+		// the file may have shrunk since the session was saved
+		if (restore->saved.start <= buffer_length(buffer)) {
+			pane->start = restore->saved.start;
+			pane->end = restore->saved.end;
+			pane->line_start = restore->saved.line_start;
+		}
+		buffer_set_cursor(buffer, restore->saved.cursor);
+
+		session_restores.unordered_remove(i);
+		i--;
+	}
+}
@@ -15,14 +15,32 @@
 #define GLYPH_INVERT 0x1
 #define GLYPH_BLINK 0x2
 
+// colors a cell can use, the shaders declare a palette uniform of this size
+#define PALETTE_SIZE 16
+
+// the largest font the zoom shortcuts, the settings window and the config can ask for
+#define MAX_FONT_SIZE 60
+
+#define UTF8_IS_CONTINUATION(c) ((((u8) (c)) & 0xC0) == 0x80)
+
+#define PROFILE_HISTORY 240
+#define PROFILE_SCOPE_NAME(line) profile_scope_##line
+#define PROFILE_SCOPE_LINE(zone, line) ProfileScope PROFILE_SCOPE_NAME(line)(zone)
+#define PROFILE_SCOPE(zone) PROFILE_SCOPE_LINE(zone, __LINE__)
+
 enum Mode {
 	MODE_INSERT = 0,
 	MODE_NORMAL,
 	MODE_COMMAND,
     MODE_VISUAL,
+	MODE_VISUAL_BLOCK,
 	MODES_COUNT
 };
 
+struct SaveJob;
+struct LoadJob;
+struct Journal;
+
 struct Buffer {
 	Mode mode;
 	char *data;
@@ -34,6 +52,73 @@ struct Buffer {
     
 	u32 cursor;
     s32 cursor_width;
+
+	// cursors besides the primary one, sorted and never equal to cursor
+	Array<u32> cursors;
+
+	// line_starts[i] is the position of line i, only a prefix of the lines is indexed
+	Array<u32> line_starts;
+
+	// the last indexed line has no line break before this, so a long last line is searched once
+	u32 lines_scanned;
+
+	// line_rows[i] is the first visual row of line i when lines wrap at wrap_width cells,
+	// computed for a prefix of the indexed lines and cut back along with them
+	Array<u32> line_rows;
+	u32 wrap_width;
+
+	// tabs run to the next multiple of tab_width cells
+	u32 tab_width;
+
+	// line_kinds[i] tells whether line i is plain, when it is a visual column is a byte offset,
+	// worked out the first time a column of the line is asked for and dropped when the line changes
+	Array<u8> line_kinds;
+
+	// bumped by every edit, equal to saved_version when the buffer matches the file
+	u32 edit_version;
+	u32 saved_version;
+
+	// file size and modification time as last loaded or saved
+	u64 disk_size;
+	u64 disk_mtime;
+	bool changed_on_disk;
+
+	// the file changed while a load or save was running, checked again once it is done
+	bool watch_pending;
+
+	// restored from a session and not read yet, see session_poll
+	bool load_deferred;
+
+	// the file could not be read to the end, writing the buffer over it would cut it short
+	bool load_incomplete;
+
+	// where a reload puts the cursor back once all of the file is in, UINT32_MAX when none waits
+	u32 load_cursor;
+
+	SaveJob *save_job;
+	LoadJob *load_job;
+	Journal *journal;
+};
+
+enum LineKind {
+	LINE_UNKNOWN = 0,
+	LINE_PLAIN,
+	LINE_MIXED
+};
+
+// a block selection spans lines top to bottom and columns left to right, all inclusive
+struct Block {
+	u32 top;
+	u32 bottom;
+	u32 left;
+	u32 right;
+};
+
+// a range of the buffer as it lies in memory, a range crossing the gap is two of these
+struct BufferSpan {
+	const char *data;
+	u32 length;
+	u32 pos;
 };
 
 enum InputEventType {
@@ -58,6 +143,22 @@ struct InputEvent {
 	char ch;
 };
 
+struct InputTraceEvent {
+	f64 time;
+	InputEvent event;
+
+	f64 dispatch_time;
+	f64 latency;
+};
+
+struct InputTrace {
+	Array<InputTraceEvent> events;
+	u32 next_event;
+	u32 pending_event;
+	f64 start_time;
+	bool max_speed;
+};
+
 struct Bounds {
 	u32 left;
 	u32 top;
@@ -82,6 +183,19 @@ struct Pane {
 	u32 start;
 	u32 end;
     u32 line_start;
+
+	// visual rows of the first line scrolled off the top, only when lines wrap
+	u32 row_offset;
+
+	// cells of every line scrolled off to the left, only when lines do not wrap
+	u32 column_offset;
+
+	// the first visible character of the cursor line and the cell it starts at, the cursor
+	// column is counted from here so a long line is not walked from its start every frame
+	u32 anchor;
+	u32 anchor_cell;
+	u32 anchor_line;
+	u32 anchor_version;
 };
 
 enum ColorPalette : u32 {
@@ -97,6 +211,20 @@ enum ColorPalette : u32 {
 	COLOR_COUNT
 };
 
+static_assert(COLOR_COUNT <= PALETTE_SIZE, "the shader palette cannot hold every color");
+
+enum ProfileZone : u32 {
+	PROFILE_INPUT = 0,
+	PROFILE_SCROLL,
+	PROFILE_HIGHLIGHT,
+	PROFILE_RENDER_PANE,
+	PROFILE_UPLOAD,
+	PROFILE_DRAW,
+	PROFILE_IMGUI,
+	PROFILE_SWAP,
+	PROFILE_ZONES_COUNT
+};
+
 struct Settings {
 	u32 colors[COLOR_COUNT];
 	u32 tab_width;
@@ -104,10 +232,15 @@ struct Settings {
     f32 opacity;
 	bool vsync;
 	bool hardware_rendering;
+	bool soft_wrap;
 
 	bool show;
+	bool show_profiler;
 	bool last_hardware_rendering;
 
+	// changed since the config was read, save_settings writes it back
+	bool dirty;
+
 	/* TODO: maybe rework this later */
 	f32 bg_temp[3];
 	f32 fg_temp[3];
@@ -128,16 +261,19 @@ struct FontMetrics {
 
 struct GlyphMap {
 	FontMetrics metrics;
+	u32 pixel_size;
 	u8 *data;
 	u32 width;
 	u32 height;
 };
 
+// 8 bytes, colors are indices into the palette, the settings colors, laid out as the shaders read it
 struct Cell {
-	u32 glyph_index;
-	u32 glyph_flags;
-	u32 foreground;
-	u32 background;
+	u16 glyph_index;
+	u8 glyph_flags;
+	u8 foreground;
+	u8 background;
+	u8 padding[3];
 };
 
 struct DrawBuffer {
@@ -160,6 +296,7 @@ struct Renderer {
 	virtual void end() = 0;
 	virtual void query_cell_data() = 0;
 	virtual void query_settings(Settings *settings) = 0;
+	virtual void query_glyph_map() = 0;
 	virtual void update_time(f64 time) = 0;
 };
 
@@ -177,6 +314,7 @@ struct HardwareRenderer : Renderer {
 	s32 shader_win_size_slot;
 	s32 shader_time_slot;
 	s32 shader_background_color_slot;
+	s32 shader_palette_slot;
 
 	void reinit(s32 width, s32 height);
 	void deinit();
@@ -184,6 +322,7 @@ struct HardwareRenderer : Renderer {
 	void end();
 	void query_cell_data();
 	void query_settings(Settings *settings);
+	void query_glyph_map();
 	void update_time(f64 time);
 };
 
@@ -191,7 +330,7 @@ struct SoftwareRenderer : Renderer {
 	volatile u32 *screen = 0;
 	s32 width;
 	s32 height;
-	u32 bg_color;
+	u32 palette[PALETTE_SIZE];
 
 	u32 vao;
 	u32 vbo;
@@ -205,9 +344,8 @@ struct SoftwareRenderer : Renderer {
 	void end();
 	void query_cell_data();
 	void query_settings(Settings *settings);
+	void query_glyph_map();
 	void update_time(f64 time);
-
-	void render_cell(Cell *cell, u32 column, u32 row);
 };
 
 struct Editor {
@@ -226,8 +364,6 @@ struct Editor {
 };
 
 // common functions
-void read_file_to_buffer(Buffer *buffer);
-void write_buffer_to_file(Buffer *buffer);
 char *read_entire_file(const char *file_path);
 u32 color_hex_from_rgb(f32 rgb[3]);
 void color_set_rgb_from_hex(f32 rgb[3], u32 hex);
@@ -236,21 +372,64 @@ u32 color_invert(u32 c);
 #define CHECK_OPENGL_ERROR() if (check_opengl_error()) printf("at %s:%d\n", __FILE__, __LINE__);
 bool check_opengl_error();
 
+// editor functions
+void draw_buffer_init(DrawBuffer *buffer);
+Bounds bounds_scale(Bounds bounds, u32 from_columns, u32 from_rows, u32 to_columns, u32 to_rows);
+void draw_buffer_resize(Editor *ed, DrawBuffer *buffer, GlyphMap *glyph_map, s32 width, s32 height);
+void render_pane(Editor *ed, DrawBuffer *draw_buffer, Pane *pane, bool is_active_pane);
+void render(Editor *ed, DrawBuffer *draw_buffer);
+void set_default_settings(Settings *settings);
+void load_settings_file_or_set_default(Settings *settings);
+void save_settings(Settings *settings);
+void settings_reload(Editor *ed);
+const char *settings_file_path();
+
 // buffer functions
 Buffer *buffer_create(u32 size);
+void buffer_destroy(Buffer *buffer);
 void buffer_delete_forwards(Buffer *buffer, u32 pos);
 void buffer_delete_backwards(Buffer *buffer, u32 pos);
 void buffer_delete_multiple(Buffer *buffer, u32 pos, u32 count);
+void buffer_delete_ranges(Buffer *buffer, const u32 *ranges, u32 count);
 void buffer_insert(Buffer *buffer, u32 pos, char ch);
+void buffer_insert_multiple(Buffer *buffer, u32 pos, const char *text, u32 length);
+void buffer_insert_at_cursors(Buffer *buffer, const char *text, u32 length);
+void buffer_delete_at_cursors(Buffer *buffer, bool forwards);
+void buffer_move_cursors(Buffer *buffer, u32 (*move)(Buffer *buffer, u32 cursor));
+void buffer_add_cursor(Buffer *buffer, u32 pos);
+void buffer_clear_cursors(Buffer *buffer);
+u32 buffer_find(Buffer *buffer, const char *text, u32 length, u32 from);
+void buffer_replace(Buffer *buffer, u32 pos, char ch);
 u32 buffer_length(Buffer *buffer);
 char buffer_get_char(Buffer *buffer, u32 cursor);
+void buffer_get_text(Buffer *buffer, u32 from, u32 to, char *text);
+u32 buffer_get_spans(Buffer *buffer, u32 from, u32 to, BufferSpan spans[2]);
 u32 buffer_get_line(Buffer *buffer, char *line, u32 line_size, u32 *cursor);
 void buffer_grow_if_needed(Buffer *buffer, u32 size_needed);
+void buffer_shift_gap_to_position(Buffer *buffer, u32 pos);
 void buffer_clear(Buffer *buffer);
 u32 buffer_line_length(Buffer *buffer, u32 cursor);
 void buffer_set_cursor(Buffer *buffer, u32 cursor);
 void buffer_goto_beginning(Buffer *buffer);
 void buffer_goto_next_line(Buffer *buffer);
+u32 buffer_get_line_start(Buffer *buffer, u32 line);
+u32 buffer_get_line_index(Buffer *buffer, u32 pos);
+u32 buffer_get_line_end(Buffer *buffer, u32 line);
+void buffer_invalidate_lines(Buffer *buffer, u32 pos);
+void buffer_set_wrap(Buffer *buffer, u32 width, u32 tab_width);
+u32 buffer_advance_cells(Buffer *buffer, u32 from, u32 to, u32 cell);
+u32 buffer_find_cell(Buffer *buffer, u32 from, u32 from_cell, u32 cell, u32 *found_cell);
+u32 buffer_get_cell_column(Buffer *buffer, u32 pos);
+u32 buffer_get_cell_position(Buffer *buffer, u32 line, u32 column);
+u32 buffer_count_codepoints(Buffer *buffer, u32 from, u32 to);
+u32 buffer_get_line_row(Buffer *buffer, u32 line);
+u32 buffer_get_row_line(Buffer *buffer, u32 row);
+u32 buffer_get_row(Buffer *buffer, u32 pos, u32 *column);
+u32 buffer_get_row_position(Buffer *buffer, u32 row, u32 column);
+bool buffer_is_dirty(Buffer *buffer);
+Block buffer_get_block(Buffer *buffer);
+void buffer_get_block_range(Buffer *buffer, Block block, u32 line, u32 *from, u32 *to);
+void buffer_get_block_ranges(Buffer *buffer, Block block, Array<u32> *ranges);
 
 // cursor functions
 u32 cursor_next(Buffer *buffer, u32 cursor);
@@ -261,15 +440,22 @@ u32 cursor_get_beginning_of_next_line(Buffer *buffer, u32 cursor);
 u32 cursor_get_beginning_of_prev_line(Buffer *buffer, u32 cursor);
 u32 cursor_get_end_of_prev_line(Buffer *buffer, u32 cursor);
 u32 cursor_get_end_of_next_line(Buffer *buffer, u32 cursor);
-u32 cursor_get_column(Buffer *buffer, u32 cursor);
 u32 cursor_get_beginning_of_word(Buffer *buffer, u32 cursor);
 u32 cursor_get_end_of_word(Buffer *buffer, u32 cursor);
 u32 cursor_get_next_word(Buffer *buffer, u32 cursor);
 u32 cursor_get_prev_word(Buffer *buffer, u32 cursor);
+u32 char_get_type(char c);
+
+// utf8 functions
+bool utf8_is_ascii(const char *data, u32 length);
+u32 utf8_count_codepoints(const char *data, u32 length);
 
 // pane functions
 Pane *pane_create(Editor *ed, Bounds bounds);
 void pane_update_scroll(Pane *pane);
+void pane_update_wrap(Pane *pane, Settings *settings);
+u32 pane_get_gutter_width(Pane *pane);
+u32 pane_get_visible_start(Pane *pane, u32 line, u32 *cell);
 void pane_split_vertically(Editor *ed);
 void pane_split_horizontally(Editor *ed);
 
@@ -278,6 +464,35 @@ Keymap *keymap_create_empty();
 void keymap_dispatch_event(Editor *ed);
 void create_default_keymaps(Editor *ed);
 
+// register functions
+typedef const char *(*ClipboardGetCallback)(Editor *ed);
+typedef void (*ClipboardSetCallback)(Editor *ed, const char *text);
+
+void register_yank(Buffer *buffer, char reg, u32 from, u32 to, bool linewise, bool deleted);
+void register_yank_ranges(Buffer *buffer, char reg, const u32 *ranges, u32 count, bool deleted);
+void register_put(Editor *ed, Buffer *buffer, char reg, bool before);
+void registers_set_clipboard(ClipboardGetCallback get, ClipboardSetCallback set);
+void registers_sync_clipboard(Editor *ed);
+
+// macro functions
+void macro_record_begin(char reg);
+void macro_record_end();
+bool macro_get_recording(char *reg);
+void macro_record_event(InputEvent event);
+void macro_replay(Editor *ed, char reg);
+
+// input trace functions
+bool input_trace_record_begin(const char *path, f64 now);
+void input_trace_record(InputEvent event, f64 now);
+void input_trace_record_end();
+bool input_trace_load(InputTrace *trace, const char *path);
+void input_trace_replay_begin(InputTrace *trace, f64 now, bool max_speed);
+bool input_trace_replay_next(InputTrace *trace, f64 now, InputEvent *event);
+f64 input_trace_next_event_time(InputTrace *trace);
+void input_trace_frame_presented(InputTrace *trace, f64 now);
+bool input_trace_replay_done(InputTrace *trace);
+void input_trace_report(InputTrace *trace);
+
 // commands functions
 void command_begin(Editor *ed);
 void command_confirm(Editor *ed);
@@ -290,6 +505,73 @@ char command_buffer_get(u32 i);
 // highlighting functions
 void highlighting_parse(Pane *pane);
 
+// rasterizer functions
+void software_rasterize(DrawBuffer *buffer, GlyphMap *glyph_map, u32 *screen, s32 width, s32 height, const u32 *palette);
+
+// profiler functions
+f64 profiler_now();
+void profiler_add(ProfileZone zone, f64 start, f64 end);
+void profiler_frame_end();
+const char *profiler_zone_name(u32 zone);
+u32 profiler_history_count();
+f64 profiler_history_get(u32 age, u32 zone);
+f64 profiler_zone_percentile(u32 zone, f64 p);
+bool profiler_export_chrome_trace(const char *path);
+
+struct ProfileScope {
+	ProfileZone zone;
+	f64 start;
+
+	ProfileScope(ProfileZone zone) : zone(zone), start(profiler_now()) {}
+	~ProfileScope() { profiler_add(zone, start, profiler_now()); }
+};
+
+// load functions
+void read_file_to_buffer(Buffer *buffer);
+bool load_get_progress(Buffer *buffer, u32 *percent);
+void load_poll();
+void load_wait_all(bool cancel);
+void load_file_tail(Buffer *buffer);
+
+// session functions
+void session_save(Editor *ed, DrawBuffer *draw_buffer);
+bool session_restore(Editor *ed, DrawBuffer *draw_buffer);
+void session_poll(Editor *ed);
+
+// journal functions
+void journal_init();
+void journal_shutdown();
+void journal_recover();
+void journal_insert(Buffer *buffer, u32 pos, char ch);
+void journal_insert_text(Buffer *buffer, u32 pos, const char *text, u32 length);
+void journal_delete(Buffer *buffer, u32 pos, u32 count);
+void journal_replace(Buffer *buffer, u32 pos, char ch);
+void journal_discard(Buffer *buffer);
+void journal_batch_begin();
+void journal_batch_end();
+void journal_saved(Buffer *buffer);
+void journal_save_failed(Buffer *buffer);
+
+// watch functions
+typedef void (*WatchCallback)(Editor *ed);
+
+void watch_init();
+void watch_file(const char *path, WatchCallback callback);
+void watch_update_disk_state(Buffer *buffer);
+void watch_recheck(Buffer *buffer);
+void watch_poll(Editor *ed, f64 now);
+void watch_shutdown();
+
+// save functions
+bool write_buffer_to_file(Buffer *buffer);
+void buffer_save_async(Buffer *buffer);
+void save_prepare_edit(Buffer *buffer, u32 from, u32 to);
+bool save_get_progress(Buffer *buffer, u32 *percent);
+void save_poll();
+void save_wait_all();
+
 // glyph map functions
 void glyph_map_init();
-GlyphMap *glyph_map_create(const char *font, u32 pixel_size);
\ No newline at end of file
+GlyphMap *glyph_map_create(const char *font, u32 pixel_size);
+void glyph_map_request(const char *font, u32 pixel_size);
+GlyphMap *glyph_map_poll();
\ No newline at end of file
@@ -7,62 +7,109 @@
 	Shortcut shortcut_##name = {#name, shortcut_fn_##name}; \
 	void shortcut_fn_##name(Editor *ed)
 
-#define MAX_NORMAL_LENGTH 16
-static char normal_buffer[MAX_NORMAL_LENGTH];
-static u32 normal_index = 0;
-
-bool normal_mode_get_shortcut(Editor *ed, Shortcut *shortcut);
+// keys are bytes, ctrl combinations are folded into the control codes below 32
+#define NORMAL_KEY_COUNT 128
+#define MAX_NORMAL_COUNT 99999999
+#define MAX_NORMAL_SEARCH_LENGTH 256
+
+#define MOTION(name, linewise, inclusive) \
+	static u32 motion_fn_##name(Buffer *buffer, u32 pos, u32 count); \
+	static const Motion motion_##name = {motion_fn_##name, linewise, inclusive}; \
+	static u32 motion_fn_##name(Buffer *buffer, u32 pos, u32 count)
+
+// returned by a motion that cannot move at all, like j on the last line, so an operator does nothing
+#define MOTION_FAILED UINT32_MAX
+
+// returns where count repetitions of the motion take pos, count is 0 when none was typed
+typedef u32 (*MotionFunction)(Buffer *buffer, u32 pos, u32 count);
+
+struct Motion {
+	MotionFunction function;
+
+	// linewise motions cover whole lines, inclusive ones also cover the character they land on
+	bool linewise;
+	bool inclusive;
+};
+
+// applies one edit to [from, to)
+typedef void (*OperatorFunction)(Editor *ed, u32 from, u32 to, bool linewise);
+
+// one state of the normal mode parser, a child of 0 means the sequence cannot continue with that key
+struct NormalNode {
+	Shortcut *shortcut;
+	const Motion *motion;
+	OperatorFunction op;
+	bool repeat;
+	bool takes_register;
+	bool has_children;
+	u16 children[NORMAL_KEY_COUNT];
+};
+
+// node 0 is the root, the state is the node reached by the keys typed so far
+static Array<NormalNode> normal_nodes;
+static u16 normal_node = 0;
+static u32 normal_count = 0;
+
+// an operator typed without a motion waits here for one
+static OperatorFunction normal_operator = 0;
+static u32 normal_operator_count = 0;
+
+// the register named by "{register} or by the key after a binding that takes one, it lasts for one command
+static u16 normal_register_node = 0;
+static bool normal_register_prefix = false;
+static char normal_register = 0;
 
 SHORTCUT(null) {
 	
 }
 
+// insert mode edits and motions apply to every cursor
 SHORTCUT(insert_char) {
 	Buffer *buffer = ed->current_buffer;
 	InputEvent input_event = ed->last_input_event;
 
-	buffer_insert(buffer, buffer->cursor, input_event.ch);
+	buffer_insert_at_cursors(buffer, &input_event.ch, 1);
 }
 
 SHORTCUT(delete_forwards) {
 	Buffer *buffer = ed->current_buffer;
-	buffer_delete_forwards(buffer, buffer->cursor);
+	buffer_delete_at_cursors(buffer, true);
 }
 
 SHORTCUT(delete_backwards) {
 	Buffer *buffer = ed->current_buffer;
-	buffer_delete_backwards(buffer, buffer->cursor);
+	buffer_delete_at_cursors(buffer, false);
 }
 	
 SHORTCUT(cursor_back) {
 	Buffer *buffer = ed->current_buffer;
-	buffer->cursor = cursor_back(buffer, buffer->cursor);
+	buffer_move_cursors(buffer, cursor_back);
 }
 
 SHORTCUT(cursor_next) {
 	Buffer *buffer = ed->current_buffer;
-	buffer->cursor = cursor_next(buffer, buffer->cursor);
+	buffer_move_cursors(buffer, cursor_next);
 }
 
 SHORTCUT(insert_new_line) {
 	Buffer *buffer = ed->current_buffer;
-	buffer_insert(buffer, buffer->cursor, '\n');
+	buffer_insert_at_cursors(buffer, "\n", 1);
 }
 
 SHORTCUT(insert_tab) {
 	Buffer *buffer = ed->current_buffer;
-	buffer_insert(buffer, buffer->cursor, '\t');
+	buffer_insert_at_cursors(buffer, "\t", 1);
 }
 
 SHORTCUT(goto_beginning_of_line) {
 	Buffer *buffer = ed->current_buffer;
-	buffer->cursor = cursor_get_beginning_of_line(buffer, buffer->cursor);
+	buffer_move_cursors(buffer, cursor_get_beginning_of_line);
 	buffer->mode = MODE_INSERT;
 }
 
 SHORTCUT(goto_end_of_line) {
 	Buffer *buffer = ed->current_buffer;
-	buffer->cursor = cursor_get_end_of_line(buffer, buffer->cursor);
+	buffer_move_cursors(buffer, cursor_get_end_of_line);
 	buffer->mode = MODE_INSERT;
 }
 
@@ -74,71 +121,12 @@ SHORTCUT(insert_mode) {
 SHORTCUT(insert_mode_next) {
 	Buffer *buffer = ed->current_buffer;
 	buffer->mode = MODE_INSERT;
-	buffer->cursor = cursor_next(buffer, buffer->cursor);
-}
-
-SHORTCUT(next_line) {
-	Buffer *buffer = ed->current_buffer;
-	u32 column = cursor_get_column(buffer, buffer->cursor);
-	u32 beginning_of_next_line = cursor_get_beginning_of_next_line(buffer, buffer->cursor);
-	u32 next_line_length = buffer_line_length(buffer, beginning_of_next_line);
-
-	buffer_set_cursor(buffer, beginning_of_next_line + MIN(next_line_length, column));
-}
-
-SHORTCUT(prev_line) {
-	Buffer *buffer = ed->current_buffer;
-	u32 column = cursor_get_column(buffer, buffer->cursor);
-	u32 beginning_of_prev_line = cursor_get_beginning_of_prev_line(buffer, buffer->cursor);
-	u32 prev_line_length = buffer_line_length(buffer, beginning_of_prev_line);
-
-	buffer_set_cursor(buffer, beginning_of_prev_line + MIN(prev_line_length, column));
-}
- 
-SHORTCUT(go_word_next) {
-	Buffer *buffer = ed->current_buffer;
-	buffer->cursor = cursor_get_next_word(buffer, buffer->cursor);
-}
-
-SHORTCUT(go_word_end) {
-	Buffer *buffer = ed->current_buffer;
-	
-	if (isspace(buffer_get_char(buffer, buffer->cursor))) {
-		buffer->cursor = cursor_get_next_word(buffer, buffer->cursor);
-	} else if (buffer->cursor + 1 < buffer_length(buffer) &&
-			   isspace(buffer_get_char(buffer, buffer->cursor + 1))) {
-		buffer->cursor = cursor_get_next_word(buffer, buffer->cursor);
-	}  else {
-		buffer->cursor = cursor_get_end_of_word(buffer, buffer->cursor);
-	}
-}	
-
-SHORTCUT(go_word_prev) {
-	Buffer *buffer = ed->current_buffer;
-
-	if (isspace(buffer_get_char(buffer, buffer->cursor))) {
-		buffer->cursor = cursor_get_prev_word(buffer, buffer->cursor);
-	} else if (buffer->cursor - 1 >= 0 &&
-			   isspace(buffer_get_char(buffer, buffer->cursor - 1))) {
-		buffer->cursor = cursor_get_prev_word(buffer, buffer->cursor);
-	}  else {
-		buffer->cursor = cursor_get_beginning_of_word(buffer, buffer->cursor);
-	}
-}
-	
-
-SHORTCUT(goto_buffer_begin) {
-	Buffer *buffer = ed->current_buffer;
-	buffer->cursor = 0;
-}
-
-SHORTCUT(goto_buffer_end) {
-	Buffer *buffer = ed->current_buffer;
-	buffer->cursor = buffer_length(buffer);
+	buffer_move_cursors(buffer, cursor_next);
 }
 
 SHORTCUT(new_line_before) {
 	Buffer *buffer = ed->current_buffer;
+	buffer_clear_cursors(buffer);
 	shortcut_fn_goto_beginning_of_line(ed);
 	shortcut_fn_insert_new_line(ed);
 	
@@ -147,6 +135,7 @@ SHORTCUT(new_line_before) {
 
 SHORTCUT(new_line_after) {
 	Buffer *buffer = ed->current_buffer;
+	buffer_clear_cursors(buffer);
 	shortcut_fn_goto_end_of_line(ed);
 	shortcut_fn_insert_new_line(ed);
 }
@@ -185,51 +174,420 @@ SHORTCUT(split_horizontally) {
 	buffer->mode = MODE_NORMAL;
 }
 
+SHORTCUT(normal_mode_clear) {
+	normal_node = 0;
+	normal_count = 0;
+	normal_operator = 0;
+	normal_operator_count = 0;
+	normal_register_node = 0;
+	normal_register_prefix = false;
+	normal_register = 0;
+}
+
+SHORTCUT(normal_escape) {
+	Buffer *buffer = ed->current_buffer;
+	buffer_clear_cursors(buffer);
+	shortcut_fn_normal_mode_clear(ed);
+}
+
 SHORTCUT(normal_mode) {
 	Buffer *buffer = ed->current_buffer;
 	buffer->cursor_width = 0;
-	buffer->cursor = cursor_back(buffer, buffer->cursor);
+	buffer_move_cursors(buffer, cursor_back);
 	buffer->mode = MODE_NORMAL;
-	normal_index = 0;
-	normal_buffer[normal_index] = 0;
+	shortcut_fn_normal_mode_clear(ed);
 }
 
-SHORTCUT(normal_mode_clear) {
-	normal_index = 0;
-	normal_buffer[normal_index] = 0;
+// h and l stay on the line, so 5x near its end or x on an empty line never joins lines
+MOTION(left, false, false) {
+	u32 line_start = cursor_get_beginning_of_line(buffer, pos);
+	for (u32 i = 0; i < MAX(count, 1u) && pos > line_start; ++i) {
+		pos = cursor_back(buffer, pos);
+	}
+	return pos;
 }
 
-SHORTCUT(normal_insert) {
-	if (normal_index + 2 >= MAX_NORMAL_LENGTH) {
+MOTION(right, false, false) {
+	u32 line_end = cursor_get_end_of_line(buffer, pos);
+	for (u32 i = 0; i < MAX(count, 1u) && pos < line_end; ++i) {
+		pos = cursor_next(buffer, pos);
+	}
+	return pos;
+}
+
+// moves by whole lines through the line index, so 1000j is one lookup and not 1000 scans,
+// keeping the visual column so tabs line up
+static u32 motion_by_lines(Buffer *buffer, u32 pos, s64 lines) {
+	u32 column = buffer_get_cell_column(buffer, pos);
+	s64 line = (s64) buffer_get_line_index(buffer, pos) + lines;
+
+	return buffer_get_cell_position(buffer, (u32) MIN(MAX(line, (s64) 0), (s64) UINT32_MAX), column);
+}
+
+// a count past the first or last line stops there, but no line to move to at all is a failure
+static u32 motion_by_lines_or_fail(Buffer *buffer, u32 pos, s64 lines) {
+	u32 target = motion_by_lines(buffer, pos, lines);
+	return buffer_get_line_index(buffer, target) == buffer_get_line_index(buffer, pos) ? MOTION_FAILED : target;
+}
+
+MOTION(down, true, false) {
+	return motion_by_lines_or_fail(buffer, pos, MAX(count, 1u));
+}
+
+MOTION(up, true, false) {
+	return motion_by_lines_or_fail(buffer, pos, -(s64) MAX(count, 1u));
+}
+
+// moves by visual rows, which are lines unless they wrap
+static u32 motion_by_rows(Buffer *buffer, u32 pos, s64 rows) {
+	u32 column;
+	s64 row = (s64) buffer_get_row(buffer, pos, &column) + rows;
+
+	return buffer_get_row_position(buffer, (u32) MIN(MAX(row, (s64) 0), (s64) UINT32_MAX), column);
+}
+
+MOTION(row_down, false, false) {
+	return motion_by_rows(buffer, pos, MAX(count, 1u));
+}
+
+MOTION(row_up, false, false) {
+	return motion_by_rows(buffer, pos, -(s64) MAX(count, 1u));
+}
+
+// a doubled operator like dd covers the current line and count - 1 below it
+MOTION(lines, true, false) {
+	return count > 1 ? motion_by_lines(buffer, pos, count - 1) : pos;
+}
+
+MOTION(word_next, false, false) {
+	u32 length = buffer_length(buffer);
+	for (u32 i = 0; i < MAX(count, 1u) && pos < length; ++i) {
+		pos = MIN(cursor_get_next_word(buffer, pos), length);
+	}
+	return pos;
+}
+
+MOTION(word_end, false, true) {
+	u32 length = buffer_length(buffer);
+	for (u32 i = 0; i < MAX(count, 1u) && pos < length; ++i) {
+		u32 next = cursor_next(buffer, pos);
+
+		if (isspace((u8) buffer_get_char(buffer, pos)) ||
+			(next < length && isspace((u8) buffer_get_char(buffer, next)))) {
+			pos = cursor_get_next_word(buffer, pos);
+		} else {
+			pos = cursor_get_end_of_word(buffer, pos);
+		}
+		pos = MIN(pos, length);
+	}
+	return pos;
+}
+
+// cw changes to the end of the word like ce, but does not skip past a one letter word
+MOTION(word_end_change, false, true) {
+	for (u32 i = 1; i < count; ++i) {
+		pos = cursor_get_next_word(buffer, pos);
+	}
+	return MIN(cursor_get_end_of_word(buffer, pos), buffer_length(buffer));
+}
+
+MOTION(word_prev, false, false) {
+	for (u32 i = 0; i < MAX(count, 1u) && pos > 0; ++i) {
+		if (isspace((u8) buffer_get_char(buffer, pos)) ||
+			isspace((u8) buffer_get_char(buffer, cursor_back(buffer, pos)))) {
+			pos = cursor_get_prev_word(buffer, pos);
+		} else {
+			pos = cursor_get_beginning_of_word(buffer, pos);
+		}
+	}
+	return pos;
+}
+
+MOTION(line_begin, false, false) {
+	return cursor_get_beginning_of_line(buffer, pos);
+}
+
+MOTION(line_end, false, false) {
+	for (u32 i = 1; i < count; ++i) {
+		pos = cursor_get_beginning_of_next_line(buffer, pos);
+	}
+	return cursor_get_end_of_line(buffer, pos);
+}
+
+MOTION(buffer_begin, true, false) {
+	return count > 0 ? buffer_get_line_start(buffer, count - 1) : 0;
+}
+
+MOTION(buffer_end, true, false) {
+	return count > 0 ? buffer_get_line_start(buffer, count - 1) : buffer_length(buffer);
+}
+
+static void operator_delete(Editor *ed, u32 from, u32 to, bool linewise) {
+	Buffer *buffer = ed->current_buffer;
+	register_yank(buffer, normal_register, from, to, linewise, true);
+	buffer_delete_multiple(buffer, from, to - from);
+	buffer_set_cursor(buffer, from);
+}
+
+static void operator_change(Editor *ed, u32 from, u32 to, bool linewise) {
+	Buffer *buffer = ed->current_buffer;
+
+	// changed lines keep the line break after them
+	if (linewise && to > from && buffer_get_char(buffer, to - 1) == '\n') {
+		to--;
+	}
+
+	register_yank(buffer, normal_register, from, to, linewise, true);
+	buffer_delete_multiple(buffer, from, to - from);
+	buffer_set_cursor(buffer, from);
+	buffer->mode = MODE_INSERT;
+}
+
+static void operator_yank(Editor *ed, u32 from, u32 to, bool linewise) {
+	Buffer *buffer = ed->current_buffer;
+	register_yank(buffer, normal_register, from, to, linewise, false);
+	buffer_set_cursor(buffer, from);
+}
+
+// the motion is computed once and the operator, if any, edits the whole range in one go
+static void normal_apply_motion(Editor *ed, OperatorFunction op, const Motion *motion, u32 count) {
+	Buffer *buffer = ed->current_buffer;
+
+	if (!op) {
+		u32 target = motion->function(buffer, buffer->cursor, count);
+		if (target != MOTION_FAILED) buffer_set_cursor(buffer, target);
 		return;
 	}
 
-	InputEvent input_event = ed->last_input_event;
-	char ch = input_event.ch;
-	u16 key_comb = input_event.key_comb;
+	// normal mode edits happen at the primary cursor only, the others would be left pointing at stale text
+	buffer_clear_cursors(buffer);
+
+	if (op == operator_change && motion == &motion_word_next &&
+		!isspace((u8) buffer_get_char(buffer, buffer->cursor))) {
+		motion = &motion_word_end_change;
+	}
+
+	u32 target = motion->function(buffer, buffer->cursor, count);
+	if (target == MOTION_FAILED) return;
+
+	u32 from = MIN(buffer->cursor, target);
+	u32 to = MAX(buffer->cursor, target);
+
+	if (motion->linewise) {
+		from = cursor_get_beginning_of_line(buffer, from);
+		to = cursor_get_beginning_of_next_line(buffer, to);
+	} else if (motion->inclusive && to < buffer_length(buffer)) {
+		to = cursor_next(buffer, to);
+	}
+
+	// x on an empty line deletes nothing and leaves the register alone, c still starts inserting
+	if (from == to && op != operator_change) return;
+
+	op(ed, from, to, motion->linewise);
+}
+
+static void normal_run(Editor *ed, NormalNode *node) {
+	u32 count = normal_count;
+	OperatorFunction op = normal_operator;
+	char reg = normal_register;
+
+	// counts before the operator and before the motion multiply, 2d3w deletes 6 words
+	if (op && normal_operator_count > 0) {
+		count = count > 0 ? (u32) MIN((u64) count * normal_operator_count, (u64) MAX_NORMAL_COUNT) : normal_operator_count;
+	}
+
+	shortcut_fn_normal_mode_clear(ed);
+	normal_register = reg;
+
+	if (node->op && !node->motion) {
+		if (!op) {
+			// the count and register wait with the operator for its motion
+			normal_operator = node->op;
+			normal_operator_count = count;
+			return;
+		}
+
+		if (op == node->op) {
+			normal_apply_motion(ed, op, &motion_lines, count);
+		}
+	} else if (node->motion) {
+		normal_apply_motion(ed, op ? op : node->op, node->motion, count);
+	} else if (!op) {
+		// anything else cancels a pending operator
+		if (node->takes_register && !reg) {
+			normal_register_node = (u16) (node - normal_nodes.data);
+			normal_count = count;
+			return;
+		}
+
+		// a replayed macro runs commands of its own, which reset normal_register
+		u32 repeat = node->repeat && count > 0 ? count : 1;
+		for (u32 i = 0; i < repeat; ++i) {
+			normal_register = reg;
+			node->shortcut->function(ed);
+		}
+	}
+
+	normal_register = 0;
+}
+
+static void normal_feed(Editor *ed, u32 key) {
+	if (normal_register_node || normal_register_prefix) {
+		u16 node_index = normal_register_node;
+		normal_register_node = 0;
+		normal_register_prefix = false;
+
+		if (key <= ' ' || key >= NORMAL_KEY_COUNT) {
+			shortcut_fn_normal_mode_clear(ed);
+		} else {
+			normal_register = (char) key;
+			if (node_index) {
+				normal_run(ed, &normal_nodes[node_index]);
+			}
+		}
+		return;
+	}
+
+	if (normal_node == 0 && key == '"') {
+		normal_register_prefix = true;
+		return;
+	}
+
+	if (normal_node == 0 && isdigit(key) && (key != '0' || normal_count > 0)) {
+		normal_count = MIN(normal_count * 10 + (key - '0'), (u32) MAX_NORMAL_COUNT);
+		return;
+	}
+
+	NormalNode *node = &normal_nodes[normal_node];
+	u16 next = key < NORMAL_KEY_COUNT ? node->children[key] : 0;
+
+	if (next == 0) {
+		// a prefix that is also a binding was waiting for this key, it runs alone and the key starts over
+		if (normal_node != 0 && (node->shortcut || node->motion || node->op)) {
+			normal_node = 0;
+			normal_run(ed, node);
+			normal_feed(ed, key);
+		} else {
+			shortcut_fn_normal_mode_clear(ed);
+		}
+		return;
+	}
+
+	normal_node = next;
+	node = &normal_nodes[next];
+
+	if (!node->has_children) {
+		normal_node = 0;
+		normal_run(ed, node);
+	}
+}
+
+SHORTCUT(macro_record) {
+	macro_record_begin(normal_register);
+}
+
+SHORTCUT(macro_replay) {
+	macro_replay(ed, normal_register);
+}
+
+SHORTCUT(put_after) {
+	Buffer *buffer = ed->current_buffer;
+	buffer_clear_cursors(buffer);
+	register_put(ed, buffer, normal_register, false);
+}
+
+SHORTCUT(put_before) {
+	Buffer *buffer = ed->current_buffer;
+	buffer_clear_cursors(buffer);
+	register_put(ed, buffer, normal_register, true);
+}
+
+// adds a cursor in the same column of the line past the last cursor in that direction
+static void cursor_add_vertically(Buffer *buffer, s64 lines) {
+	u32 from = buffer->cursor;
+	if (buffer->cursors.length > 0) {
+		from = lines > 0 ? MAX(from, buffer->cursors[buffer->cursors.length - 1]) : MIN(from, buffer->cursors[0]);
+	}
+
+	u32 column = buffer_get_cell_column(buffer, from);
+	s64 line = (s64) buffer_get_line_index(buffer, from) + lines;
+	if (line < 0) return;
+
+	u32 line_start = buffer_get_line_start(buffer, (u32) MIN(line, (s64) UINT32_MAX));
+	if (buffer_get_line_index(buffer, line_start) != line) return;
+
+	buffer_add_cursor(buffer, buffer_get_cell_position(buffer, (u32) line, column));
+}
+
+SHORTCUT(cursor_add_below) {
+	cursor_add_vertically(ed->current_buffer, 1);
+}
+
+SHORTCUT(cursor_add_above) {
+	cursor_add_vertically(ed->current_buffer, -1);
+}
+
+// adds a cursor on the next occurrence of the word under the primary cursor, after the last cursor
+SHORTCUT(cursor_add_next_match) {
+	Buffer *buffer = ed->current_buffer;
+	u32 length = buffer_length(buffer);
+	if (buffer->cursor >= length) return;
+
+	u32 type = char_get_type(buffer_get_char(buffer, buffer->cursor));
+	u32 word_start = buffer->cursor;
+	u32 word_end = buffer->cursor + 1;
+	while (word_start > 0 && char_get_type(buffer_get_char(buffer, word_start - 1)) == type) word_start--;
+	while (word_end < length && char_get_type(buffer_get_char(buffer, word_end)) == type) word_end++;
+
+	u32 word_length = word_end - word_start;
+	if (word_length > MAX_NORMAL_SEARCH_LENGTH) return;
 
-	if (key_comb & CTRL) {
-		normal_buffer[normal_index++] = '^';
-		normal_buffer[normal_index++] = ch;
+	char word[MAX_NORMAL_SEARCH_LENGTH];
+	buffer_get_text(buffer, word_start, word_end, word);
 
-	} else {
-		normal_buffer[normal_index++] = ch;
+	u32 last = buffer->cursors.length > 0 ? MAX(buffer->cursor, buffer->cursors[buffer->cursors.length - 1]) : buffer->cursor;
+	u32 offset = buffer->cursor - word_start;
+
+	// search on from the last cursor's word and wrap around to the top
+	u32 match = buffer_find(buffer, word, word_length, last - MIN(last, offset) + 1);
+	if (match == length) {
+		match = buffer_find(buffer, word, word_length, 0);
 	}
 
-	normal_buffer[normal_index] = 0;
+	if (match < length) {
+		buffer_add_cursor(buffer, match + offset);
+	}
+}
+
+SHORTCUT(normal_insert) {
+	InputEvent input_event = ed->last_input_event;
+	u32 key = (u8) input_event.ch;
 
-	Shortcut shortcut;
-	bool exists = normal_mode_get_shortcut(ed, &shortcut);
-	if (exists) {
-		shortcut.function(ed);
-		shortcut_fn_normal_mode_clear(ed);
+	if (input_event.key_comb & CTRL) {
+		key &= 0x1F;
 	}
+
+	normal_feed(ed, key);
 }
 
 SHORTCUT(show_settings) {
 	ed->settings.show = !ed->settings.show;
 }
 
+SHORTCUT(show_profiler) {
+	ed->settings.show_profiler = !ed->settings.show_profiler;
+}
+
+SHORTCUT(font_zoom_in) {
+	Settings *settings = &ed->settings;
+	settings->font_size = MIN(settings->font_size + 1, MAX_FONT_SIZE);
+}
+
+SHORTCUT(font_zoom_out) {
+	Settings *settings = &ed->settings;
+	settings->font_size = MAX(settings->font_size, 2) - 1;
+}
+
 SHORTCUT(quit) {
 	ed->running = false;
 }
@@ -252,15 +610,17 @@ SHORTCUT(visual_mode_line) {
 
 SHORTCUT(visual_next) {
 	Buffer *buffer = ed->current_buffer;
-	if (buffer->cursor + buffer->cursor_width < buffer_length(buffer)) {
-		buffer->cursor_width++;
+	u32 cursor = (s32)(buffer->cursor) + buffer->cursor_width;
+	if (cursor < buffer_length(buffer)) {
+		buffer->cursor_width += cursor_next(buffer, cursor) - cursor;
 	}
 }
 
 SHORTCUT(visual_back) {
 	Buffer *buffer = ed->current_buffer;
-	if (buffer->cursor + buffer->cursor_width > 0) {
-		buffer->cursor_width--;
+	u32 cursor = (s32)(buffer->cursor) + buffer->cursor_width;
+	if (cursor > 0) {
+		buffer->cursor_width -= cursor - cursor_back(buffer, cursor);
 	}
 }
 
@@ -268,7 +628,6 @@ SHORTCUT(visual_next_line) {
 	Buffer *buffer = ed->current_buffer;
 
 	u32 cursor = (s32)(buffer->cursor) + buffer->cursor_width;
-	u32 column = cursor_get_column(buffer, cursor);
 	u32 end = cursor_get_end_of_next_line(buffer, cursor);
 
 	buffer->cursor_width += end - cursor;
@@ -279,7 +638,6 @@ SHORTCUT(visual_prev_line) {
 
 	u32 cursor = (s32)(buffer->cursor) + buffer->cursor_width;
 
-	u32 column = cursor_get_column(buffer, cursor);
 	u32 end = cursor_get_beginning_of_prev_line(buffer, cursor);
 
 	buffer->cursor_width -= cursor - end;
@@ -297,11 +655,13 @@ SHORTCUT(visual_word_end) {
 	Buffer *buffer = ed->current_buffer;
 	u32 cursor = (s32)(buffer->cursor) + buffer->cursor_width;
 	
+	u32 next = cursor_next(buffer, cursor);
+
 	u32 end;
-	if (isspace(buffer_get_char(buffer, cursor))) {
+	if (isspace((u8) buffer_get_char(buffer, cursor))) {
 		end = cursor_get_next_word(buffer, cursor);
-	} else if (cursor + 1 < buffer_length(buffer) &&
-			   isspace(buffer_get_char(buffer, cursor + 1))) {
+	} else if (next < buffer_length(buffer) &&
+			   isspace((u8) buffer_get_char(buffer, next))) {
 		end = cursor_get_next_word(buffer, cursor);
 	}  else {
 		end = cursor_get_end_of_word(buffer, cursor);
@@ -315,10 +675,10 @@ SHORTCUT(visual_word_prev) {
 	u32 cursor = (s32)(buffer->cursor) + buffer->cursor_width;
 
 	u32 end;
-	if (isspace(buffer_get_char(buffer, cursor))) {
+	if (isspace((u8) buffer_get_char(buffer, cursor))) {
 		end = cursor_get_prev_word(buffer, cursor);
-	} else if (cursor - 1 >= 0 &&
-			   isspace(buffer_get_char(buffer, cursor - 1))) {
+	} else if (cursor > 0 &&
+			   isspace((u8) buffer_get_char(buffer, cursor_back(buffer, cursor)))) {
 		end = cursor_get_prev_word(buffer, cursor);
 	}  else {
 		end = cursor_get_beginning_of_word(buffer, cursor);
@@ -345,9 +705,126 @@ SHORTCUT(visual_buffer_end) {
 
 SHORTCUT(visual_delete) {
 	Buffer *buffer = ed->current_buffer;
-	buffer_delete_multiple(buffer, buffer->cursor, buffer->cursor_width + 1);
+	u32 from = MIN(buffer->cursor, buffer->cursor + buffer->cursor_width);
+	u32 to = cursor_next(buffer, MAX(buffer->cursor, buffer->cursor + buffer->cursor_width));
+	register_yank(buffer, 0, from, to, false, true);
+	buffer_clear_cursors(buffer);
+	buffer_delete_multiple(buffer, from, to - from);
+	buffer->mode = MODE_NORMAL;
+	buffer->cursor_width = 0;
+}
+
+SHORTCUT(visual_yank) {
+	Buffer *buffer = ed->current_buffer;
+	u32 from = MIN(buffer->cursor, buffer->cursor + buffer->cursor_width);
+	u32 to = cursor_next(buffer, MAX(buffer->cursor, buffer->cursor + buffer->cursor_width));
+	register_yank(buffer, 0, from, to, false, false);
+	buffer_set_cursor(buffer, from);
+	buffer->mode = MODE_NORMAL;
+	buffer->cursor_width = 0;
+}
+
+SHORTCUT(visual_mode_block) {
+	Buffer *buffer = ed->current_buffer;
+	buffer_clear_cursors(buffer);
+	buffer->mode = MODE_VISUAL_BLOCK;
+	buffer->cursor_width = 0;
+}
+
+// the corner moves straight up and down, keeping its column
+static void visual_block_move_lines(Buffer *buffer, s64 lines) {
+	u32 cursor = (s32)(buffer->cursor) + buffer->cursor_width;
+	u32 end = motion_by_lines(buffer, cursor, lines);
+
+	buffer->cursor_width += (s32) (end - cursor);
+}
+
+SHORTCUT(visual_block_next_line) {
+	visual_block_move_lines(ed->current_buffer, 1);
+}
+
+SHORTCUT(visual_block_prev_line) {
+	visual_block_move_lines(ed->current_buffer, -1);
+}
+
+// a cursor at the character covering column, or after it, on every line of the block that is
+// at least min_columns long, so what is typed next goes into all of them
+static void visual_block_insert_at(Buffer *buffer, Block block, u32 column, u32 min_columns, bool after) {
+	bool has_primary = false;
+
+	for (u32 line = block.top; line <= block.bottom; ++line) {
+		u32 line_end = buffer_get_line_end(buffer, line);
+		if (buffer_get_cell_column(buffer, line_end) < min_columns) continue;
+
+		u32 pos = buffer_get_cell_position(buffer, line, column);
+		if (after && pos < line_end) {
+			pos = cursor_next(buffer, pos);
+		}
+
+		if (!has_primary) {
+			buffer->cursor = pos;
+			has_primary = true;
+		} else {
+			buffer_add_cursor(buffer, pos);
+		}
+	}
+
+	buffer->cursor_width = 0;
+	buffer->mode = MODE_INSERT;
+}
+
+// yanks and removes the block in one batched edit, returns its corners as they were
+static Block visual_block_remove(Buffer *buffer) {
+	Block block = buffer_get_block(buffer);
+
+	Array<u32> ranges;
+	buffer_get_block_ranges(buffer, block, &ranges);
+
+	u32 count = (u32) ranges.length / 2;
+	register_yank_ranges(buffer, 0, ranges.data, count, true);
+	buffer_clear_cursors(buffer);
+	buffer_delete_ranges(buffer, ranges.data, count);
+
+	buffer->cursor = buffer_get_cell_position(buffer, block.top, block.left);
+	buffer->cursor_width = 0;
+	return block;
+}
+
+SHORTCUT(visual_block_delete) {
+	Buffer *buffer = ed->current_buffer;
+	visual_block_remove(buffer);
 	buffer->mode = MODE_NORMAL;
+}
+
+SHORTCUT(visual_block_change) {
+	Buffer *buffer = ed->current_buffer;
+	Block block = visual_block_remove(buffer);
+	visual_block_insert_at(buffer, block, block.left, block.left, false);
+}
+
+SHORTCUT(visual_block_yank) {
+	Buffer *buffer = ed->current_buffer;
+	Block block = buffer_get_block(buffer);
+
+	Array<u32> ranges;
+	buffer_get_block_ranges(buffer, block, &ranges);
+	register_yank_ranges(buffer, 0, ranges.data, (u32) ranges.length / 2, false);
+
+	buffer->cursor = buffer_get_cell_position(buffer, block.top, block.left);
 	buffer->cursor_width = 0;
+	buffer->mode = MODE_NORMAL;
+}
+
+SHORTCUT(visual_block_insert) {
+	Buffer *buffer = ed->current_buffer;
+	Block block = buffer_get_block(buffer);
+	visual_block_insert_at(buffer, block, block.left, block.left + 1, false);
+}
+
+SHORTCUT(visual_block_append) {
+	Buffer *buffer = ed->current_buffer;
+	Block block = buffer_get_block(buffer);
+	visual_block_insert_at(buffer, block, block.right, 0, true);
 }
 
 SHORTCUT(command_begin) {
@@ -392,127 +869,151 @@ void keymap_dispatch_event(Editor *ed) {
 	Keymap *keymap = ed->keymaps[ed->current_buffer->mode];
 
 	if (event.type == INPUT_EVENT_PRESSED) {
+		// q typed in normal mode while nothing else is pending ends a recording
+		char reg;
+		if (macro_get_recording(&reg) && ed->current_buffer->mode == MODE_NORMAL && event.ch == 'q' &&
+			!(event.key_comb & CTRL) && normal_node == 0 && normal_count == 0 &&
+			normal_operator == 0 && normal_register_node == 0 && !normal_register_prefix && normal_register == 0) {
+			macro_record_end();
+			return;
+		}
+
+		macro_record_event(event);
+
 		Shortcut *shortcut = keymap_get_shortcut(keymap, event.key_comb);
 		shortcut->function(ed);
 	}
 }
 
-/* TODO: definetly rework this! */
-bool normal_mode_get_shortcut(Editor *ed, Shortcut *shortcut) {
-	Buffer *buffer = ed->current_buffer;
-
-	switch (normal_buffer[0]) {
-		// one letter shortcuts
-		case 'x': *shortcut = shortcut_delete_forwards; break;
-		case 'h': *shortcut = shortcut_cursor_back; break;
-		case 'l': *shortcut = shortcut_cursor_next; break;
-		case 'j': *shortcut = shortcut_next_line; break;
-		case 'k': *shortcut = shortcut_prev_line; break;
-		case 'w': *shortcut = shortcut_go_word_next; break;
-		case 'e': *shortcut = shortcut_go_word_end; break;
-		case 'b': *shortcut = shortcut_go_word_prev; break;
-		case 'I': *shortcut = shortcut_goto_beginning_of_line; break;
-		case 'A': *shortcut = shortcut_goto_end_of_line; break;
-		case 'i': *shortcut = shortcut_insert_mode; break;
-		case 'a': *shortcut = shortcut_insert_mode_next; break;
-		case 'o': *shortcut = shortcut_new_line_after; break;
-		case 'O': *shortcut = shortcut_new_line_before; break;
-		case 'G': *shortcut = shortcut_goto_buffer_end; break;
-		case 'v': *shortcut = shortcut_visual_mode; break;
-		case 'V': *shortcut = shortcut_visual_mode_line; break;
-
-		default: {
-			
-			// window operations
-			if (strcmp(normal_buffer, "^Wv") == 0) { *shortcut = shortcut_split_vertically; break; }
-			else if (strcmp(normal_buffer, "^W^V") == 0) { *shortcut = shortcut_split_vertically; break; }
-			else if (strcmp(normal_buffer, "^Ws") == 0) { *shortcut = shortcut_split_horizontally; break; }
-			else if (strcmp(normal_buffer, "^W^S") == 0) { *shortcut = shortcut_split_horizontally; break; }
-			else if (strcmp(normal_buffer, "^Wl") == 0) { *shortcut = shortcut_next_pane; break; }
-			else if (strcmp(normal_buffer, "^W^L") == 0) { *shortcut = shortcut_next_pane; break; }
-			else if (strcmp(normal_buffer, "^Wh") == 0) { *shortcut = shortcut_prev_pane; break; }
-			else if (strcmp(normal_buffer, "^W^H") == 0) { *shortcut = shortcut_prev_pane; break; }
-
-			else {
-				// two letter shortcuts
-				char c1 = normal_buffer[0];
-				if (normal_index == 2 && !isdigit(c1)) {
-					char c2 = normal_buffer[1];
-
-					if (c1 == 'g' && c2 == 'g') {
-						shortcut_fn_goto_buffer_begin(ed);
-						shortcut_fn_normal_mode_clear(ed);
-						return false;
-					} else if (c1 == 'd') {
-						if (c2 == 'd') {
-							u32 from = cursor_get_beginning_of_line(buffer, buffer->cursor);
-							u32 to = cursor_get_beginning_of_next_line(buffer, buffer->cursor);
-							
-							buffer_delete_multiple(buffer, from, (to - from));
-
-							shortcut_fn_normal_mode_clear(ed);
-							return false;
-						} else if (c2 == 'w') {
-							u32 from = buffer->cursor;
-							u32 to = cursor_get_next_word(buffer, buffer->cursor);
-
-							buffer_delete_multiple(buffer, from, (to - from));
-
-							shortcut_fn_normal_mode_clear(ed);
-							return false;
-						} else  {
-							return false;
-						}
-					} else if (c1 == 'c' && c2 == 'w') {
-						u32 from = buffer->cursor;
-						u32 to = cursor_get_end_of_word(buffer, buffer->cursor);
-
-						buffer_delete_multiple(buffer, from, (to - from) + 1);
-
-						shortcut_fn_normal_mode_clear(ed);
-						shortcut_fn_insert_mode(ed); 
-						return false;
-					} else {
-						return false;
-					}
-				} else {
-					// number followed by command
-
-					if (isdigit(normal_buffer[0])) {
-						u32 end = 0;
-
-						while (isdigit(normal_buffer[end])) {
-							end++;
-						}
-
-						char number_str[MAX_NUMBER_LENGTH];
-						memcpy(number_str, normal_buffer, end);
-						number_str[end] = 0;
-						u32 number = atoi(number_str);
-
-        				if (end < strlen(normal_buffer)) {
-							char dir = normal_buffer[end];
-							if (dir == 'j') {
-								for (u32 i = 0; i < number; ++i) {
-									shortcut_fn_next_line(ed);
-								}
-							} else if (dir == 'k') {
-								for (u32 i = 0; i < number; ++i) {
-									shortcut_fn_prev_line(ed);
-								}
-							}
-
-							shortcut_fn_normal_mode_clear(ed);
-						}
-					}
-
-					return false;
-				}
-			}
+// a binding's keys are typed literally, "^W" is ctrl+w
+struct NormalBinding {
+	const char *keys;
+	Shortcut *shortcut;
+
+	// a count before the keys runs the shortcut that many times
+	bool repeat;
+
+	// with both set the operator is applied over the motion right away, x is d + l
+	const Motion *motion;
+	OperatorFunction op;
+
+	// the key after the sequence names a register
+	bool takes_register;
+};
+
+static const NormalBinding normal_bindings[] = {
+	// motions, also the targets of operators
+	{"h", 0, false, &motion_left},
+	{"l", 0, false, &motion_right},
+	{"j", 0, false, &motion_down},
+	{"k", 0, false, &motion_up},
+	{"w", 0, false, &motion_word_next},
+	{"e", 0, false, &motion_word_end},
+	{"b", 0, false, &motion_word_prev},
+	{"0", 0, false, &motion_line_begin},
+	{"$", 0, false, &motion_line_end},
+	{"gg", 0, false, &motion_buffer_begin},
+	{"gj", 0, false, &motion_row_down},
+	{"gk", 0, false, &motion_row_up},
+	{"G", 0, false, &motion_buffer_end},
+
+	// operators, doubled they work on whole lines
+	{"d", 0, false, 0, operator_delete},
+	{"c", 0, false, 0, operator_change},
+	{"y", 0, false, 0, operator_yank},
+	{"x", 0, false, &motion_right, operator_delete},
+	{"X", 0, false, &motion_left, operator_delete},
+	{"D", 0, false, &motion_line_end, operator_delete},
+	{"C", 0, false, &motion_line_end, operator_change},
+	{"Y", 0, false, &motion_lines, operator_yank},
+
+	// "{register} before any of these picks the register they use
+	{"p", &shortcut_put_after, true},
+	{"P", &shortcut_put_before, true},
+
+	{"I", &shortcut_goto_beginning_of_line},
+	{"A", &shortcut_goto_end_of_line},
+	{"i", &shortcut_insert_mode},
+	{"a", &shortcut_insert_mode_next},
+	{"o", &shortcut_new_line_after, true},
+	{"O", &shortcut_new_line_before, true},
+	{"v", &shortcut_visual_mode},
+	{"V", &shortcut_visual_mode_line},
+	{"^V", &shortcut_visual_mode_block},
+
+	// multiple cursors, insert mode then edits at all of them and escape in normal mode drops them
+	{"^J", &shortcut_cursor_add_below, true},
+	{"^K", &shortcut_cursor_add_above, true},
+	{"^N", &shortcut_cursor_add_next_match, true},
+
+	// macros, q{register} records until the next q and {count}@{register} replays
+	{"q", &shortcut_macro_record, false, 0, 0, true},
+	{"@", &shortcut_macro_replay, true, 0, 0, true},
+
+	// window operations
+	{"^Wv", &shortcut_split_vertically},
+	{"^W^V", &shortcut_split_vertically},
+	{"^Ws", &shortcut_split_horizontally},
+	{"^W^S", &shortcut_split_horizontally},
+	{"^Wl", &shortcut_next_pane},
+	{"^W^L", &shortcut_next_pane},
+	{"^Wh", &shortcut_prev_pane},
+	{"^W^H", &shortcut_prev_pane},
+};
+
+static void normal_add_binding(const NormalBinding *binding) {
+	u16 node_index = 0;
+
+	for (const char *c = binding->keys; *c; ++c) {
+		u32 key = (u8) *c;
+		if (key == '^' && c[1]) {
+			key = (u8) *++c & 0x1F;
+		}
+		assert(key < NORMAL_KEY_COUNT);
+
+		u16 next = normal_nodes[node_index].children[key];
+		if (next == 0) {
+			NormalNode node = {0};
+			next = (u16) normal_nodes.length;
+			normal_nodes.add(node);
+
+			normal_nodes[node_index].children[key] = next;
+			normal_nodes[node_index].has_children = true;
 		}
+
+		node_index = next;
 	}
 
-	return true;
+	normal_nodes[node_index].shortcut = binding->shortcut;
+	normal_nodes[node_index].motion = binding->motion;
+	normal_nodes[node_index].op = binding->op;
+	normal_nodes[node_index].repeat = binding->repeat;
+	normal_nodes[node_index].takes_register = binding->takes_register;
+}
+
+static void normal_build_trie() {
+	normal_nodes.clear();
+
+	NormalNode root = {0};
+	normal_nodes.add(root);
+
+	for (const NormalBinding &binding : normal_bindings) {
+		normal_add_binding(&binding);
+	}
+
+	normal_node = 0;
+	normal_count = 0;
+	normal_operator = 0;
+	normal_operator_count = 0;
+	normal_register_node = 0;
+	normal_register_prefix = false;
+	normal_register = 0;
+}
+
+static void keymap_add_font_zoom(Keymap *keymap) {
+	keymap->shortcuts['=' | CTRL] = shortcut_font_zoom_in;
+	keymap->shortcuts['=' | CTRL | SHIFT] = shortcut_font_zoom_in;
+	keymap->shortcuts['-' | CTRL] = shortcut_font_zoom_out;
 }
 
 void create_default_keymaps(Editor *ed) {
@@ -533,10 +1034,12 @@ void create_default_keymaps(Editor *ed) {
 	keymap->shortcuts[GLFW_KEY_RIGHT] = shortcut_cursor_next;
 	keymap->shortcuts[GLFW_KEY_F4 | ALT] = shortcut_quit;
 	keymap->shortcuts[GLFW_KEY_ESCAPE] = shortcut_normal_mode;
+	keymap_add_font_zoom(keymap);
 
 	ed->keymaps[MODE_INSERT] = keymap;
 	
-	// normal keymap
+	// normal keymap, key sequences go through the trie built from normal_bindings
+	normal_build_trie();
 	keymap = keymap_create_empty();
 
 	for (char ch = ' '; ch <= '~'; ++ch) {
@@ -546,8 +1049,10 @@ void create_default_keymaps(Editor *ed) {
 	}
 	keymap->shortcuts[GLFW_KEY_F4 | ALT] = shortcut_quit;
 	keymap->shortcuts[GLFW_KEY_F3] = shortcut_show_settings;
+	keymap->shortcuts[GLFW_KEY_F2] = shortcut_show_profiler;
 	keymap->shortcuts[':' | SHIFT] = shortcut_command_begin;
-	keymap->shortcuts[GLFW_KEY_ESCAPE] = shortcut_normal_mode_clear;
+	keymap->shortcuts[GLFW_KEY_ESCAPE] = shortcut_normal_escape;
+	keymap_add_font_zoom(keymap);
 
 	ed->keymaps[MODE_NORMAL] = keymap;
 	
@@ -575,9 +1080,32 @@ void create_default_keymaps(Editor *ed) {
 	keymap->shortcuts['E'] = shortcut_visual_word_end;
 	keymap->shortcuts['B'] = shortcut_visual_word_prev;
 	keymap->shortcuts['D'] = shortcut_visual_delete;
+	keymap->shortcuts['Y'] = shortcut_visual_yank;
 	keymap->shortcuts['G'] = shortcut_visual_buffer_beginning;
 	keymap->shortcuts['G' | SHIFT] = shortcut_visual_buffer_end;
 	keymap->shortcuts[GLFW_KEY_ESCAPE] = shortcut_normal_mode;
+	keymap_add_font_zoom(keymap);
 
 	ed->keymaps[MODE_VISUAL] = keymap;
+
+	// visual block keymap, edits apply to the same columns on every selected line
+	keymap = keymap_create_empty();
+
+	keymap->shortcuts['L'] = shortcut_visual_next;
+	keymap->shortcuts['H'] = shortcut_visual_back;
+	keymap->shortcuts['J'] = shortcut_visual_block_next_line;
+	keymap->shortcuts['K'] = shortcut_visual_block_prev_line;
+	keymap->shortcuts['W'] = shortcut_visual_word_next;
+	keymap->shortcuts['E'] = shortcut_visual_word_end;
+	keymap->shortcuts['B'] = shortcut_visual_word_prev;
+	keymap->shortcuts['D'] = shortcut_visual_block_delete;
+	keymap->shortcuts['X'] = shortcut_visual_block_delete;
+	keymap->shortcuts['C'] = shortcut_visual_block_change;
+	keymap->shortcuts['Y'] = shortcut_visual_block_yank;
+	keymap->shortcuts['I' | SHIFT] = shortcut_visual_block_insert;
+	keymap->shortcuts['A' | SHIFT] = shortcut_visual_block_append;
+	keymap->shortcuts[GLFW_KEY_ESCAPE] = shortcut_normal_mode;
+	keymap_add_font_zoom(keymap);
+
+	ed->keymaps[MODE_VISUAL_BLOCK] = keymap;
 }
\ No newline at end of file
@@ -0,0 +1,67 @@
+#include "shin.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define UTF8_SSE2
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define UTF8_NEON
+#endif
+
+#define UTF8_CHUNK_SIZE 16
+
+static inline bool utf8_chunk_is_ascii(const char *data) {
+#if defined(UTF8_SSE2)
+	__m128i chunk = _mm_loadu_si128((const __m128i *) data);
+	return _mm_movemask_epi8(chunk) == 0;
+#elif defined(UTF8_NEON)
+	uint8x16_t chunk = vld1q_u8((const u8 *) data);
+	return vmaxvq_u8(chunk) < 0x80;
+#else
+	u64 a, b;
+	memcpy(&a, data, sizeof(u64));
+	memcpy(&b, data + sizeof(u64), sizeof(u64));
+	return ((a | b) & 0x8080808080808080ULL) == 0;
+#endif
+}
+
+bool utf8_is_ascii(const char *data, u32 length) {
+	u32 i = 0;
+
+	for (; i + UTF8_CHUNK_SIZE <= length; i += UTF8_CHUNK_SIZE) {
+		if (!utf8_chunk_is_ascii(data + i)) {
+			return false;
+		}
+	}
+
+	for (; i < length; ++i) {
+		if ((u8) data[i] >= 0x80) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+u32 utf8_count_codepoints(const char *data, u32 length) {
+	u32 count = 0;
+	u32 i = 0;
+
+	while (i < length) {
+		// pure ascii chunks need no decoding, every byte is a codepoint
+		if (i + UTF8_CHUNK_SIZE <= length && utf8_chunk_is_ascii(data + i)) {
+			count += UTF8_CHUNK_SIZE;
+			i += UTF8_CHUNK_SIZE;
+			continue;
+		}
+
+		u32 chunk_end = MIN(i + UTF8_CHUNK_SIZE, length);
+		for (; i < chunk_end; ++i) {
+			if (!UTF8_IS_CONTINUATION(data[i])) {
+				count++;
+			}
+		}
+	}
+
+	return count;
+}
@@ -0,0 +1,301 @@
+#include "shin.h"
+
+#include <mutex>
+#include <thread>
+
+#include <sys/stat.h>
+
+#ifdef __linux__
+#include <limits.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#define WATCH_INOTIFY
+#endif
+
+// platforms without inotify stat every open file this often
+#define WATCH_POLL_INTERVAL 1.0
+
+// bytes before the old end compared to tell an append from a rewrite
+#define WATCH_TAIL_CHECK_SIZE 256
+
+// files that are not buffers, like the config
+struct WatchFile {
+	char *path;
+	WatchCallback callback;
+	u64 size;
+	u64 mtime;
+};
+
+static Array<WatchFile> watch_files;
+
+#ifdef WATCH_INOTIFY
+struct WatchDirectory {
+	s32 wd;
+	char *path;
+};
+
+static std::mutex watch_mutex;
+static Array<WatchDirectory> watch_directories;
+static Array<char *> watch_changed_paths;
+
+static s32 watch_fd = -1;
+static s32 watch_stop_pipe[2];
+static std::thread watch_thread;
+#else
+static f64 watch_last_poll = 0;
+#endif
+
+static bool watch_stat(const char *path, u64 *size, u64 *mtime) {
+	struct stat st;
+	if (stat(path, &st) != 0) return false;
+
+	*size = st.st_size;
+#ifdef __linux__
+	*mtime = (u64) st.st_mtim.tv_sec * 1000000000ULL + st.st_mtim.tv_nsec;
+#else
+	*mtime = (u64) st.st_mtime;
+#endif
+	return true;
+}
+
+#ifdef WATCH_INOTIFY
+static void watch_worker() {
+	alignas(struct inotify_event) char events[64 * (sizeof(struct inotify_event) + NAME_MAX + 1)];
+
+	struct pollfd fds[2];
+	fds[0].fd = watch_fd;
+	fds[0].events = POLLIN;
+	fds[1].fd = watch_stop_pipe[0];
+	fds[1].events = POLLIN;
+
+	while (true) {
+		if (poll(fds, 2, -1) < 0) continue;
+		if (fds[1].revents) break;
+
+		ssize_t length = read(watch_fd, events, sizeof(events));
+		if (length <= 0) continue;
+
+		std::lock_guard<std::mutex> lock(watch_mutex);
+
+		for (char *pos = events; pos < events + length;) {
+			struct inotify_event *event = (struct inotify_event *) pos;
+			pos += sizeof(struct inotify_event) + event->len;
+
+			if (event->len == 0) continue;
+
+			for (WatchDirectory &directory : watch_directories) {
+				if (directory.wd != event->wd) continue;
+
+				char path[PATH_MAX];
+				snprintf(path, sizeof(path), "%s/%s", directory.path, event->name);
+				watch_changed_paths.add(strdup(path));
+				break;
+			}
+		}
+	}
+}
+
+// watches the directory rather than the file so replacing it by rename is seen too
+static void watch_add_directory(const char *file_path) {
+	char path[PATH_MAX];
+	if (watch_fd < 0 || !realpath(file_path, path)) return;
+
+	char *slash = strrchr(path, '/');
+	if (slash == path) {
+		slash[1] = 0;
+	} else if (slash) {
+		*slash = 0;
+	}
+
+	std::lock_guard<std::mutex> lock(watch_mutex);
+
+	for (WatchDirectory &directory : watch_directories) {
+		if (strcmp(directory.path, path) == 0) return;
+	}
+
+	s32 wd = inotify_add_watch(watch_fd, path, IN_MODIFY | IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+	if (wd < 0) return;
+
+	WatchDirectory directory;
+	directory.wd = wd;
+	directory.path = strdup(path);
+	watch_directories.add(directory);
+}
+#endif
+
+void watch_init() {
+#ifdef WATCH_INOTIFY
+	watch_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (watch_fd < 0 || pipe(watch_stop_pipe) != 0) {
+		fprintf(stderr, "Failed to start the file watcher\n");
+		return;
+	}
+
+	watch_thread = std::thread(watch_worker);
+#endif
+}
+
+void watch_shutdown() {
+#ifdef WATCH_INOTIFY
+	if (watch_thread.joinable()) {
+		char stop = 0;
+		if (write(watch_stop_pipe[1], &stop, 1) == 1) {
+			watch_thread.join();
+		} else {
+			watch_thread.detach();
+		}
+	}
+#endif
+}
+
+void watch_file(const char *path, WatchCallback callback) {
+	WatchFile file;
+	file.callback = callback;
+	file.size = 0;
+	file.mtime = 0;
+
+#ifdef WATCH_INOTIFY
+	char resolved_path[PATH_MAX];
+	file.path = strdup(realpath(path, resolved_path) ? resolved_path : path);
+	watch_add_directory(path);
+#else
+	file.path = strdup(path);
+#endif
+
+	watch_stat(file.path, &file.size, &file.mtime);
+	watch_files.add(file);
+}
+
+static void watch_check_file(Editor *ed, WatchFile *file) {
+	u64 size, mtime;
+	if (!watch_stat(file->path, &size, &mtime)) return;
+	if (size == file->size && mtime == file->mtime) return;
+
+	file->size = size;
+	file->mtime = mtime;
+	file->callback(ed);
+}
+
+void watch_update_disk_state(Buffer *buffer) {
+	if (!buffer->file_path) return;
+
+	watch_stat(buffer->file_path, &buffer->disk_size, &buffer->disk_mtime);
+
+#ifdef WATCH_INOTIFY
+	watch_add_directory(buffer->file_path);
+#endif
+}
+
+static bool watch_is_append(Buffer *buffer, u64 size) {
+	if (size <= buffer->disk_size || buffer_length(buffer) != buffer->disk_size) return false;
+
+	FILE *file = fopen(buffer->file_path, "rb");
+	if (!file) return false;
+
+	char tail[WATCH_TAIL_CHECK_SIZE];
+	u32 check_size = (u32) MIN(buffer->disk_size, (u64) WATCH_TAIL_CHECK_SIZE);
+	u32 check_start = (u32) buffer->disk_size - check_size;
+
+	fseek(file, check_start, SEEK_SET);
+	bool same = fread(tail, 1, check_size, file) == check_size;
+	fclose(file);
+
+	for (u32 i = 0; same && i < check_size; ++i) {
+		same = tail[i] == buffer_get_char(buffer, check_start + i);
+	}
+
+	return same;
+}
+
+static void watch_check_buffer(Buffer *buffer) {
+	if (!buffer->file_path) return;
+
+	// the change event is gone by the time the job is done, so remember to look again
+	if (buffer->load_job || buffer->save_job) {
+		buffer->watch_pending = true;
+		return;
+	}
+
+	u64 size, mtime;
+	if (!watch_stat(buffer->file_path, &size, &mtime)) return;
+	if (size == buffer->disk_size && mtime == buffer->disk_mtime) return;
+
+	// a partly read buffer is reloaded too, unless it was edited since
+	if (buffer->edit_version != buffer->saved_version) {
+		buffer->changed_on_disk = true;
+		return;
+	}
+
+	if (watch_is_append(buffer, size)) {
+		load_file_tail(buffer);
+	} else {
+		// only the first chunk is in when this returns, the load puts the cursor back
+		buffer->load_cursor = buffer->cursor;
+		read_file_to_buffer(buffer);
+	}
+}
+
+void watch_recheck(Buffer *buffer) {
+	if (!buffer->watch_pending || buffer->load_job || buffer->save_job) return;
+
+	buffer->watch_pending = false;
+	watch_check_buffer(buffer);
+}
+
+void watch_poll(Editor *ed, f64 now) {
+	for (u32 i = 0; i < ed->pane_count; ++i) {
+		watch_recheck(ed->pane_pool[i].buffer);
+	}
+
+#ifdef WATCH_INOTIFY
+	Array<char *> changed_paths;
+	{
+		std::lock_guard<std::mutex> lock(watch_mutex);
+		if (watch_changed_paths.length == 0) return;
+
+		for (char *path : watch_changed_paths) {
+			changed_paths.add(path);
+		}
+		watch_changed_paths.clear();
+	}
+
+	for (u32 i = 0; i < ed->pane_count; ++i) {
+		Buffer *buffer = ed->pane_pool[i].buffer;
+
+		char path[PATH_MAX];
+		if (!buffer->file_path || !realpath(buffer->file_path, path)) continue;
+
+		for (char *changed_path : changed_paths) {
+			if (strcmp(changed_path, path) == 0) {
+				watch_check_buffer(buffer);
+				break;
+			}
+		}
+	}
+
+	for (WatchFile &file : watch_files) {
+		for (char *changed_path : changed_paths) {
+			if (strcmp(changed_path, file.path) == 0) {
+				watch_check_file(ed, &file);
+				break;
+			}
+		}
+	}
+
+	for (char *path : changed_paths) {
+		free(path);
+	}
+#else
+	if (now - watch_last_poll < WATCH_POLL_INTERVAL) return;
+	watch_last_poll = now;
+
+	for (u32 i = 0; i < ed->pane_count; ++i) {
+		watch_check_buffer(ed->pane_pool[i].buffer);
+	}
+
+	for (WatchFile &file : watch_files) {
+		watch_check_file(ed, &file);
+	}
+#endif
+}
@@ -0,0 +1,87 @@
+#include "../src/shin.h"
+
+/*
+ * Headless normal mode tests: types keys into a one pane editor and checks the
+ * text and cursor left behind. Prints every failing case and exits with 1.
+ *
+ * usage: shin_normal_test
+ */
+
+struct NormalTest {
+	const char *name;
+	const char *text;
+	u32 cursor;
+	const char *keys;
+	const char *expected_text;
+	u32 expected_cursor;
+};
+
+static const NormalTest NORMAL_TESTS[] = {
+	{"x deletes the character under the cursor", "abc\ndef\n", 1, "x", "ac\ndef\n", 1},
+	{"a count past the line end stops at it", "abc\ndef\n", 1, "5x", "a\ndef\n", 1},
+	{"x on an empty line keeps the line break", "abc\n\ndef\n", 4, "x", "abc\n\ndef\n", 4},
+	{"X stops at the line start", "abc\ndef\n", 5, "5X", "abc\nef\n", 4},
+	{"d3l stays on the line", "abc\ndef\n", 2, "d3l", "ab\ndef\n", 2},
+	{"l stops at the line end", "abc\ndef\n", 0, "9l", "abc\ndef\n", 3},
+	{"h stops at the line start", "abc\ndef\n", 6, "9h", "abc\ndef\n", 4},
+	{"dj deletes two lines", "abc\ndef\nghi\n", 0, "dj", "ghi\n", 0},
+	{"dj on the last line does nothing", "abc\ndef", 5, "dj", "abc\ndef", 5},
+	{"dk on the first line does nothing", "abc\ndef\n", 1, "dk", "abc\ndef\n", 1},
+	{"d5j past the last line deletes to it", "abc\ndef\nghi", 0, "d5j", "", 0},
+	{"j on the last line stays put", "abc\ndef", 5, "j", "abc\ndef", 5},
+};
+
+static void type_keys(Editor *ed, const char *keys) {
+	for (const char *key = keys; *key; ++key) {
+		u16 key_comb = (u8) toupper(*key);
+		if (isupper((u8) *key)) key_comb |= SHIFT;
+
+		ed->last_input_event.type = INPUT_EVENT_PRESSED;
+		ed->last_input_event.key_comb = key_comb;
+		ed->last_input_event.ch = *key;
+		keymap_dispatch_event(ed);
+	}
+}
+
+static bool run_test(Editor *ed, const NormalTest *test) {
+	Buffer *buffer = ed->current_buffer;
+	buffer_clear(buffer);
+	buffer_insert_multiple(buffer, 0, test->text, strlen(test->text));
+	buffer->mode = MODE_NORMAL;
+	buffer_set_cursor(buffer, test->cursor);
+
+	type_keys(ed, test->keys);
+
+	u32 length = buffer_length(buffer);
+	char *text = (char *) malloc(length + 1);
+	buffer_get_text(buffer, 0, length, text);
+	text[length] = 0;
+
+	bool ok = strcmp(text, test->expected_text) == 0 && buffer->cursor == test->expected_cursor;
+	if (!ok) {
+		printf("FAIL %s: \"%s\" with '%s' gave ", test->name, test->text, test->keys);
+		printf("\"%s\" cursor %u, expected \"%s\" cursor %u\n", text, buffer->cursor, test->expected_text, test->expected_cursor);
+	}
+
+	free(text);
+	return ok;
+}
+
+int main() {
+	static Editor editor;
+	editor.running = true;
+	set_default_settings(&editor.settings);
+	create_default_keymaps(&editor);
+
+	Pane *pane = pane_create(&editor, {0, 0, 80, 24});
+	editor.current_buffer = pane->buffer;
+
+	u32 test_count = sizeof(NORMAL_TESTS) / sizeof(NormalTest);
+	u32 failed = 0;
+	for (u32 i = 0; i < test_count; ++i) {
+		if (!run_test(&editor, &NORMAL_TESTS[i])) failed++;
+	}
+
+	printf("%u of %u normal mode tests passed\n", test_count - failed, test_count);
+	return failed > 0 ? 1 : 0;
+}